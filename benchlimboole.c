@@ -0,0 +1,262 @@
+/* Throughput benchmarks for the front-end of limboole.  The benchmarks need
+ * access to the static functions of 'limboole.c' and thus include it.
+ */
+
+#include "limboole.c"
+
+#include <time.h>
+
+/*------------------------------------------------------------------------*/
+
+#define BENCH_USAGE \
+"usage: benchlimboole [-h] [-m <mbytes>] [-j <threads>] [ lex | flat | deep ]\n" \
+"\n" \
+"  -h             print this command line summary and exit\n" \
+"  -m <mbytes>    size of the generated formula (default 1024)\n" \
+"  -j <threads>   parse top-level conjunctions in parallel (default 1)\n" \
+"\n" \
+"  lex            lex a flat formula (default)\n" \
+"  flat           parse a flat formula\n" \
+"  deep           parse a formula nested as deep as its size allows\n"
+
+/*------------------------------------------------------------------------*/
+
+static unsigned rng_state = 1;
+static int threads = 1;
+
+static unsigned
+rng (void)
+{
+  rng_state = rng_state * 1664525u + 1013904223u;
+  return rng_state >> 8;
+}
+
+/*------------------------------------------------------------------------*/
+/* Generates a syntactically valid flat formula similar to machine generated
+ * inputs: clauses of long variable names joined by '&', with some comments,
+ * negations, implications and indentation.
+ */
+static char *
+generate_flat (size_t size, size_t * len_ptr)
+{
+  size_t len, i, k;
+  char *res;
+  int n;
+
+  res = (char *) malloc (size + 256);
+  len = 0;
+  res[len++] = '(';
+
+  while (len < size)
+    {
+      if (!(rng () % 64))
+	len += sprintf (res + len, "\n%% comment %u\n", rng ());
+
+      res[len++] = '(';
+      k = 2 + rng () % 4;
+      for (i = 0; i < k; i++)
+	{
+	  if (i)
+	    len += sprintf (res + len, (rng () & 1) ? " | " : "|");
+	  if (rng () & 1)
+	    res[len++] = '!';
+	  n = sprintf (res + len, "signal_%u.bit[%u]", rng () % 100000,
+		       rng () % 64);
+	  len += n;
+	}
+      if (!(rng () % 8))
+	len += sprintf (res + len, " -> x%u", rng () % 1000);
+      len += sprintf (res + len, ")\n  & ");
+    }
+
+  len += sprintf (res + len, "last)");
+  *len_ptr = len;
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+/* Generates a formula in which every operator is nested into the previous
+ * one, which gives a nesting depth linear in the size of the formula.
+ */
+static char *
+generate_deep (size_t size, size_t * len_ptr)
+{
+  static const char *open[] = {
+    "(x%u & ", "!(x%u | ", "(x%u -> ", "(x%u <-> ", "!!(x%u & ",
+  };
+  size_t len, depth;
+  char *res;
+
+  res = (char *) malloc (size + 256);
+  len = depth = 0;
+
+  while (len + depth < size)
+    {
+      len += sprintf (res + len, open[rng () % 5], rng () % 1000);
+      depth++;
+    }
+
+  len += sprintf (res + len, "last");
+  while (depth--)
+    res[len++] = ')';
+  res[len] = 0;
+
+  *len_ptr = len;
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+/* Wall clock time, since parsing may use several threads.
+ */
+static double
+wall_clock (void)
+{
+  struct timespec ts;
+
+  timespec_get (&ts, TIME_UTC);
+
+  return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+/*------------------------------------------------------------------------*/
+
+static double
+seconds (double start)
+{
+  return wall_clock () - start;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+bench_lex (char *input, size_t len)
+{
+  unsigned long long tokens;
+  double start;
+  double time;
+  Mgr *mgr;
+  int res;
+
+  mgr = init ();
+  mgr->input = input;
+  mgr->input_length = len;
+  mgr->log = stdout;
+  tokens = 0;
+
+  start = wall_clock ();
+  do
+    {
+      next_token (mgr);
+      tokens++;
+    }
+  while (mgr->token != DONE && mgr->token != ERROR);
+  time = seconds (start);
+
+  res = mgr->token == DONE;
+  printf ("lex    %8.1f MB  %12llu tokens  %8.2f seconds  %8.1f MB/s\n",
+	  len / (double) (1 << 20), tokens, time,
+	  time > 0 ? len / (double) (1 << 20) / time : 0);
+
+  release (mgr);
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+bench_parse (const char *name, char *input, size_t len)
+{
+  double start;
+  double time;
+  Mgr *mgr;
+  int res;
+
+  mgr = init ();
+  mgr->input = input;
+  mgr->input_length = len;
+  mgr->log = stdout;
+
+  mgr->threads = threads;
+
+  start = wall_clock ();
+  reserve_nodes (mgr, len / 16);
+  if (parse_parallel (mgr))
+    res = 1;
+  else
+    {
+      next_token (mgr);
+      res = parse (mgr);
+    }
+  time = seconds (start);
+
+  printf ("%-6s %8.1f MB  %12u nodes   %8.2f seconds  %8.1f MB/s\n",
+	  name, len / (double) (1 << 20), mgr->nodes_count, time,
+	  time > 0 ? len / (double) (1 << 20) / time : 0);
+
+  release (mgr);
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+
+int
+main (int argc, char **argv)
+{
+  const char *mode;
+  size_t mbytes, len;
+  char *input;
+  int res;
+  int i;
+
+  mbytes = 1024;
+  mode = "lex";
+
+  for (i = 1; i < argc; i++)
+    {
+      if (!strcmp (argv[i], "-h"))
+	{
+	  printf (BENCH_USAGE);
+	  return 0;
+	}
+      else if (!strcmp (argv[i], "-m") && i + 1 < argc)
+	mbytes = (size_t) atol (argv[++i]);
+      else if (!strcmp (argv[i], "-j") && i + 1 < argc)
+	threads = atoi (argv[++i]);
+      else if (argv[i][0] != '-')
+	mode = argv[i];
+      else
+	{
+	  fprintf (stderr, "*** invalid option '%s' (try '-h')\n", argv[i]);
+	  return 1;
+	}
+    }
+
+  if (!strcmp (mode, "lex"))
+    {
+      input = generate_flat (mbytes << 20, &len);
+      res = bench_lex (input, len);
+    }
+  else if (!strcmp (mode, "flat"))
+    {
+      input = generate_flat (mbytes << 20, &len);
+      res = bench_parse (mode, input, len);
+    }
+  else if (!strcmp (mode, "deep"))
+    {
+      input = generate_deep (mbytes << 20, &len);
+      res = bench_parse (mode, input, len);
+    }
+  else
+    {
+      fprintf (stderr, "*** unknown benchmark '%s' (try '-h')\n", mode);
+      return 1;
+    }
+
+  free (input);
+
+  return !res;
+}
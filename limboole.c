@@ -41,8 +41,78 @@ THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdarg.h>
+#include <limits.h>
+
+#ifdef LIMBOOLE_USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef LIMBOOLE_USE_WRITE
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+#ifdef LIMBOOLE_USE_THREADS
+#include <pthread.h>
+#endif
+
+/* Racing PicoSAT against DepQBF with '--race' needs both and threads.
+ */
+#if defined(LIMBOOLE_USE_PICOSAT) && defined(LIMBOOLE_USE_DEPQBF) \
+  && defined(LIMBOOLE_USE_THREADS)
+#define LIMBOOLE_RACE
+#endif
+
+/* A portfolio of PicoSAT instances with '--threads' needs threads.
+ */
+#if defined(LIMBOOLE_USE_PICOSAT) && defined(LIMBOOLE_USE_THREADS)
+#define LIMBOOLE_PORTFOLIO
+#endif
+
+#ifdef LIMBOOLE_USE_SERVE
+#ifndef LIMBOOLE_USE_THREADS
+#error "'LIMBOOLE_USE_SERVE' requires 'LIMBOOLE_USE_THREADS'"
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+/* The lexer classifies blocks of characters with SIMD instructions if the
+ * compiler targets AVX2 or SSE2 and falls back to table lookups otherwise.
+ */
+#if defined(__GNUC__) && defined(__AVX2__)
+#include <immintrin.h>
+#define LEXER_BLOCK 32
+#define BLOCK_ALL 0xffffffffu
+typedef __m256i Block;
+#define BLOCK_LOAD(p) _mm256_loadu_si256 ((const __m256i *) (p))
+#define BLOCK_SET1(c) _mm256_set1_epi8 ((char) (c))
+#define BLOCK_EQ _mm256_cmpeq_epi8
+#define BLOCK_GT _mm256_cmpgt_epi8
+#define BLOCK_AND _mm256_and_si256
+#define BLOCK_OR _mm256_or_si256
+#define BLOCK_MASK(b) ((unsigned) _mm256_movemask_epi8 (b))
+#elif defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define LEXER_BLOCK 16
+#define BLOCK_ALL 0xffffu
+typedef __m128i Block;
+#define BLOCK_LOAD(p) _mm_loadu_si128 ((const __m128i *) (p))
+#define BLOCK_SET1(c) _mm_set1_epi8 ((char) (c))
+#define BLOCK_EQ _mm_cmpeq_epi8
+#define BLOCK_GT _mm_cmpgt_epi8
+#define BLOCK_AND _mm_and_si128
+#define BLOCK_OR _mm_or_si128
+#define BLOCK_MASK(b) ((unsigned) _mm_movemask_epi8 (b))
+#endif
 
 /*------------------------------------------------------------------------*/
 #ifdef LIMBOOLE_USE_LINGELING
@@ -60,6 +130,9 @@ typedef struct PicoSAT PicoSAT;
 #else
 typedef struct QDPLL QDPLL;
 #endif
+
+#include "limboole.h"
+
 /*------------------------------------------------------------------------*/
 /* These are the node types we support.  They are ordered in decreasing
  * priority: if a parent with type t1 has a child with type t2 and t1 > t2,
@@ -80,63 +153,116 @@ enum Type
   DONE = 9,
   ERROR = 10,
   ALL = 11,
-  EX = 12
+  EX = 12,
+  FALSE = 13,
+  ITE = 14,
+  COLON = 15,
+  ATMOST = 16,
+  ATLEAST = 17,
+  EXACTLY = 18,
+  COMMA = 19,
+  SEMI = 20,
+  NUMBER = 21
 };
 
 /*------------------------------------------------------------------------*/
 
 typedef enum Type Type;
-typedef struct Node Node;
-typedef union Data Data;
+typedef unsigned Ref;
 typedef struct PNode PNode;
+typedef struct Slot Slot;
+typedef struct Symbol Symbol;
 
 /*------------------------------------------------------------------------*/
+/* Nodes are identified by 32-bit node IDs starting at one and their data is
+ * kept in parallel arrays of the manager indexed by node ID.  Edges to
+ * nodes are references, i.e. node IDs shifted left by one, in which the
+ * lowest bit denotes negation.  Thus there are no NOT nodes, and since
+ * children are always created before their parents, iterating over node IDs
+ * visits children first.
+ */
 
-union Data
+struct Slot
 {
-  char *as_name;		/* variable data */
-  Node *as_child[2];		/* operator data */
+  unsigned hash;		/* cached hash value of 'node' */
+  unsigned node;		/* node ID or zero for empty slots */
 };
 
-/*------------------------------------------------------------------------*/
-
-struct Node
+/* Every variable name is stored once in the string pool of the manager.
+ * Symbols refer to their name by its offset in the pool, since the pool is
+ * reallocated while growing.
+ */
+struct Symbol
 {
-  Type type;
-  int idx;			/* tseitin index */
-  Node *next;			/* collision chain in hash table */
-  Node *next_inserted;		/* chronological list of hash table */
-  Data data;
+  unsigned hash;		/* cached hash value of the name */
+  unsigned length;		/* of the name without terminating zero */
+  size_t name;			/* offset of the name in the string pool */
+  unsigned node;		/* ID of the VAR node of this symbol or zero */
 };
 
 struct PNode 
 {
   Type type; 
-  Node *node; 
+  unsigned node; 
   PNode *next; 
 };
 
 /*------------------------------------------------------------------------*/
 
 typedef struct Mgr Mgr;
+typedef struct Backend Backend;
+typedef struct Clauses Clauses;
+
+/* Consecutive zero terminated clauses.
+ */
+struct Clauses
+{
+  int *lits;
+  size_t size;
+  size_t count;
+  unsigned num;			/* number of clauses */
+};
 
 struct Mgr
 {
-  unsigned nodes_size;
-  unsigned nodes_count;
+  unsigned char *types;		/* node types indexed by node ID */
+  unsigned char *marks;		/* one bit per sign for AND and OR children */
+  unsigned *child0;		/* symbol ID, first child or offset in 'refs' */
+  unsigned *child1;		/* second child or number of children */
+  int *idxs;			/* tseitin indices */
+  unsigned nodes_size;		/* allocated entries of the node arrays */
+  unsigned nodes_count;		/* largest node ID */
+  Ref *refs;			/* children of AND, OR, ITE and cardinality */
+  size_t refs_size;
+  size_t refs_count;
+  Ref *children;		/* children of nodes under construction */
+  unsigned children_size;
+  Ref *leaves;			/* of the parity computed by 'xor_leaves' */
+  unsigned leaves_size;
+  unsigned leaves_count;
+  Slot *table;			/* unique table */
+  unsigned table_size;		/* a power of two */
+  unsigned table_count;
+  int simplify;			/* apply the rewrite rules of 'op' and 'nary' */
+  unsigned constant;		/* ID of the FALSE node or zero */
   int idx;
   PNode *first_prefix;
-  Node **nodes;
-  Node *first;
-  Node *last;
-  Node *root;
-  char *buffer;
+  Ref root;
   char *name;
-  unsigned buffer_size;
-  unsigned buffer_count;
-  int saved_char;
-  int saved_char_is_valid;
-  int last_y;
+  Symbol *symbols;		/* indexed by 32-bit symbol IDs */
+  unsigned symbols_size;
+  unsigned symbols_count;
+  unsigned *symtab;		/* symbol ID plus one, zero for empty slots */
+  unsigned symtab_size;		/* a power of two */
+  char *pool;			/* zero terminated variable names */
+  size_t pool_size;
+  size_t pool_count;
+  unsigned symbol;		/* symbol ID of the last VAR token */
+  unsigned cardinalities;	/* open ones, in which ',' and ';' are valid */
+  int bound;			/* the next token is the bound of one */
+  unsigned number;		/* value of the last NUMBER token */
+  const char *digits;		/* and its text in the input */
+  size_t digits_length;
   int verbose;
   int use_picosat;
   int use_lingeling;
@@ -152,1273 +278,6938 @@ struct Mgr
   Type token;
   unsigned token_x;
   unsigned token_y;
-  Node **idx2node;
+  unsigned *idx2node;
+  unsigned char *polarity;	/* of nodes for Plaisted-Greenbaum encoding */
+  Ref *conjuncts;		/* of the asserted formula */
+  unsigned conjuncts_size;
+  unsigned conjuncts_count;
+  Clauses xors;			/* XOR constraints of top-level conjuncts */
+  unsigned num_clauses;		/* added to the solver */
+  const Backend *backend;	/* receiving the clauses of 'tseitin' */
+  Clauses batch;		/* clauses not yet added */
   int check_satisfiability;
   int dump;
-  int qdump;
+  int qdump;			/* dump QDIMACS with the quantifier prefix */
+  char *dump_buffer;		/* formatted output of '-d' */
+  size_t dump_count;
   PicoSAT * picosat;
   LGL * lgl;
   QDPLL *qdpll;
   int inner, outer;
   int free_vars;
+  int threads;			/* for parsing and encoding */
+  unsigned long long limit;	/* on propagations or decisions, zero if none */
+  volatile int *cancel;		/* solving stops as soon as it is set */
+#ifdef LIMBOOLE_USE_THREADS
+  pthread_mutex_t *cancel_lock;	/* of the canceller, guards 'solving' */
+  int solving;			/* PicoSAT may be interrupted */
+#endif
+  int result;			/* of the solver, zero if unknown */
+  int race;			/* PicoSAT against DepQBF with '--race' */
+  int portfolio;		/* PicoSAT instances with '--threads' */
+  Clauses cnf;			/* whole encoding for several solvers */
+  FILE *dag;			/* compiled formula written by '-c' */
+  char *dag_name;
 
   char *input;
-  unsigned int input_length;
-  unsigned int input_pos;
+  size_t input_length;
+  size_t input_pos;
+  int input_mapped;		/* 'input' is an 'mmap'ed file */
+  int input_owned;		/* 'input' has been allocated by 'load_input' */
+};
+
+/*------------------------------------------------------------------------*/
+/* Clauses are collected in a batch of consecutive zero terminated clauses,
+ * which is handed over to the back-end as a whole.  The back-end is
+ * selected once before encoding.
+ */
+struct Backend
+{
+  const char *name;
+  void (*add_clauses) (Mgr *, const int *, size_t);
 };
 
 /*------------------------------------------------------------------------*/
 
 static unsigned
-hash_var (Mgr * mgr, const char *name)
+node_id (Ref ref)
 {
-  unsigned res, tmp;
-  const char *p;
+  return ref >> 1;
+}
 
-  res = 0;
+/*------------------------------------------------------------------------*/
 
-  for (p = name; *p; p++)
-    {
-      tmp = res & 0xf0000000;
-      res <<= 4;
-      res += *p;
-      if (tmp)
-	res ^= (tmp >> 28);
-    }
+static int
+is_negated (Ref ref)
+{
+  return ref & 1;
+}
 
-  res &= (mgr->nodes_size - 1);
-  assert (res < mgr->nodes_size);
+/*------------------------------------------------------------------------*/
 
-  return res;
+static Ref
+negate (Ref ref)
+{
+  return ref ^ 1;
+}
+
+/*------------------------------------------------------------------------*/
+/* Negated references behave as NOT nodes.
+ */
+static Type
+type_of (Mgr * mgr, Ref ref)
+{
+  return is_negated (ref) ? NOT : (Type) mgr->types[node_id (ref)];
 }
 
 /*------------------------------------------------------------------------*/
 
-static unsigned
-hash_op (Mgr * mgr, Type type, Node * c0, Node * c1)
+static Ref
+child (Mgr * mgr, Ref ref, int i)
 {
-  unsigned res;
+  unsigned id;
 
-  res = (unsigned) type;
-  res += 4017271 * (unsigned) (long) c0;
-  res += 70200511 * (unsigned) (long) c1;
+  if (is_negated (ref))
+    {
+      assert (!i);
+      return negate (ref);
+    }
 
-  res &= (mgr->nodes_size - 1);
-  assert (res < mgr->nodes_size);
+  id = node_id (ref);
+  return i ? mgr->child1[id] : mgr->child0[id];
+}
 
-  return res;
+/*------------------------------------------------------------------------*/
+/* Children of AND, OR, ITE and cardinality nodes.
+ */
+static Ref *
+children (Mgr * mgr, Ref ref)
+{
+  assert (!is_negated (ref));
+  return mgr->refs + mgr->child0[node_id (ref)];
 }
 
 /*------------------------------------------------------------------------*/
 
 static unsigned
-hash (Mgr * mgr, Type type, void *c0, Node * c1)
+size_of (Mgr * mgr, Ref ref)
 {
-  if (type == VAR)
-    return hash_var (mgr, (char *) c0);
-  else
-    return hash_op (mgr, type, c0, c1);
+  assert (!is_negated (ref));
+  return mgr->child1[node_id (ref)];
 }
 
 /*------------------------------------------------------------------------*/
-
-static int
-eq_var (Node * n, const char *str)
+/* The bound 'k' of a cardinality node follows its children in 'refs'.
+ */
+static unsigned
+bound_of (Mgr * mgr, Ref ref)
 {
-  return n->type == VAR && !strcmp (n->data.as_name, str);
+  return children (mgr, ref)[size_of (mgr, ref)];
 }
 
 /*------------------------------------------------------------------------*/
-
+/* Tseitin literal of a reference.
+ */
 static int
-eq_op (Node * n, Type type, Node * c0, Node * c1)
+lit (Mgr * mgr, Ref ref)
 {
-  return n->type == type && n->data.as_child[0] == c0
-    && n->data.as_child[1] == c1;
+  int res;
+
+  res = mgr->idxs[node_id (ref)];
+  assert (res > 0);
+
+  return is_negated (ref) ? -res : res;
 }
 
 /*------------------------------------------------------------------------*/
-
-static int
-eq (Node * n, Type type, void *c0, Node * c1)
+/* Translate a reference with a map from old node IDs to new references.
+ */
+static Ref
+map_ref (Ref * map, Ref ref)
 {
-  if (type == VAR)
-    return eq_var (n, (char *) c0);
-  else
-    return eq_op (n, type, c0, c1);
+  return map[node_id (ref)] ^ is_negated (ref);
 }
 
 /*------------------------------------------------------------------------*/
+/* The symbol table maps variable names to 32-bit symbol IDs.  The lexer
+ * hashes names while scanning them and looks them up right away, thus
+ * every occurrence of a name costs one hash computation and usually one
+ * comparison with the single stored copy of the name.
+ */
 
-static Node **
-find (Mgr * mgr, Type type, void *c0, Node * c1)
+/* FNV-1a hash of variable names.
+ */
+static unsigned
+hash_name (const char *name, size_t len)
 {
-  Node **p, *n;
-  unsigned h;
+  const unsigned char *p, *end;
+  unsigned res;
 
-  h = hash (mgr, type, c0, c1);
-  for (p = mgr->nodes + h; (n = *p); p = &n->next)
-    if (eq (n, type, c0, c1))
-      break;
+  res = 2166136261u;
+  end = (const unsigned char *) name + len;
+  for (p = (const unsigned char *) name; p < end; p++)
+    res = (res ^ *p) * 16777619u;
 
-  return p;
+  return res;
 }
 
 /*------------------------------------------------------------------------*/
 
-static void
-enlarge_nodes (Mgr * mgr)
+static const char *
+symbol_name (Mgr * mgr, unsigned symbol)
 {
-  Node **old_nodes, *p, *next;
-  unsigned old_nodes_size, h, i;
-
-  old_nodes = mgr->nodes;
-  old_nodes_size = mgr->nodes_size;
-  mgr->nodes_size *= 2;
-  mgr->nodes = (Node **) calloc (mgr->nodes_size, sizeof (Node *));
-
-  for (i = 0; i < old_nodes_size; i++)
-    {
-      for (p = old_nodes[i]; p; p = next)
-	{
-	  next = p->next;
-	  if (p->type == VAR)
-	    h = hash_var (mgr, p->data.as_name);
-	  else
-	    h =
-	      hash_op (mgr, p->type, p->data.as_child[0],
-		       p->data.as_child[1]);
-	  p->next = mgr->nodes[h];
-	  mgr->nodes[h] = p;
-	}
-    }
-
-  free (old_nodes);
+  assert (symbol < mgr->symbols_count);
+  return mgr->pool + mgr->symbols[symbol].name;
 }
 
 /*------------------------------------------------------------------------*/
 
-static void
-insert (Mgr * mgr, Node * node)
+static const char *
+var_name (Mgr * mgr, unsigned id)
 {
-  if (mgr->last)
-    mgr->last->next_inserted = node;
-  else
-    mgr->first = node;
-  mgr->last = node;
-  mgr->nodes_count++;
+  assert (mgr->types[id] == VAR);
+  return symbol_name (mgr, mgr->child0[id]);
 }
 
 /*------------------------------------------------------------------------*/
-
-static Node *
-var (Mgr * mgr, const char *str)
+/* Keep the load factor of the symbol table at most one half.
+ */
+static void
+enlarge_symtab (Mgr * mgr)
 {
-  Node **p, *n;
+  unsigned *old_symtab, old_symtab_size, mask, i, j, id;
 
-  if (mgr->nodes_size <= mgr->nodes_count)
-    enlarge_nodes (mgr);
+  if (2 * (mgr->symbols_count + 1) <= mgr->symtab_size)
+    return;
 
-  p = find (mgr, VAR, (void *) str, 0);
-  n = *p;
-  if (!n)
+  old_symtab = mgr->symtab;
+  old_symtab_size = mgr->symtab_size;
+  mgr->symtab_size = old_symtab_size ? 2 * old_symtab_size : 16;
+  mgr->symtab = (unsigned *) calloc (mgr->symtab_size, sizeof (unsigned));
+  mask = mgr->symtab_size - 1;
+
+  for (j = 0; j < old_symtab_size; j++)
     {
-      n = (Node *) malloc (sizeof (*n));
-      memset (n, 0, sizeof (*n));
-      n->type = VAR;
-      n->data.as_name = strdup (str);
+      if (!(id = old_symtab[j]))
+	continue;
 
-      *p = n;
-      insert (mgr, n);
+      for (i = mgr->symbols[id - 1].hash & mask; mgr->symtab[i];
+	   i = (i + 1) & mask)
+	;
+      mgr->symtab[i] = id;
     }
 
-  return n;
+  free (old_symtab);
 }
 
 /*------------------------------------------------------------------------*/
+/* Returns the slot of the name 'name' of length 'len' with hash value 'h'
+ * in the non-empty symbol table, which is empty if the name is new.
+ */
+static unsigned *
+find_symbol (Mgr * mgr, const char *name, size_t len, unsigned h)
+{
+  unsigned mask, i, id;
+  Symbol *s;
 
-static Node *
-op (Mgr * mgr, Type type, Node * c0, Node * c1)
+  mask = mgr->symtab_size - 1;
+  for (i = h & mask; (id = mgr->symtab[i]); i = (i + 1) & mask)
+    {
+      s = mgr->symbols + id - 1;
+      if (s->hash == h && s->length == len
+	  && !memcmp (mgr->pool + s->name, name, len))
+	break;
+    }
+
+  return mgr->symtab + i;
+}
+
+/*------------------------------------------------------------------------*/
+/* Returns the symbol ID of the name 'name' of length 'len' with hash value
+ * 'h', which is added to the symbol table if it is new.
+ */
+static unsigned
+intern (Mgr * mgr, const char *name, size_t len, unsigned h)
 {
-  Node **p, *n;
+  unsigned *slot;
+  Symbol *s;
 
-  if (mgr->nodes_size <= mgr->nodes_count)
-    enlarge_nodes (mgr);
+  enlarge_symtab (mgr);
 
-  p = find (mgr, type, c0, c1);
-  n = *p;
-  if (!n)
+  slot = find_symbol (mgr, name, len, h);
+  if (*slot)
+    return *slot - 1;
+
+  if (mgr->symbols_size == mgr->symbols_count)
     {
-      n = (Node *) malloc (sizeof (*n));
-      memset (n, 0, sizeof (*n));
-      n->type = type;
-      n->data.as_child[0] = c0;
-      n->data.as_child[1] = c1;
+      mgr->symbols_size = mgr->symbols_size ? 2 * mgr->symbols_size : 16;
+      mgr->symbols = (Symbol *) realloc (mgr->symbols,
+					 mgr->symbols_size * sizeof (Symbol));
+    }
 
-      *p = n;
-      insert (mgr, n);
+  while (mgr->pool_size - mgr->pool_count <= len)
+    {
+      mgr->pool_size = mgr->pool_size ? 2 * mgr->pool_size : 1 << 12;
+      mgr->pool = (char *) realloc (mgr->pool, mgr->pool_size);
     }
 
-  return n;
+  s = mgr->symbols + mgr->symbols_count;
+  s->hash = h;
+  s->length = len;
+  s->name = mgr->pool_count;
+  s->node = 0;
+
+  memcpy (mgr->pool + mgr->pool_count, name, len);
+  mgr->pool[mgr->pool_count + len] = 0;
+  mgr->pool_count += len + 1;
+
+  *slot = ++mgr->symbols_count;
+
+  return mgr->symbols_count - 1;
 }
 
 /*------------------------------------------------------------------------*/
+/* The unique table uses open addressing with linear probing.  Every slot
+ * caches the full hash value of its node, thus probing rarely touches
+ * nodes which do not match and growing the table never rehashes nodes.
+ * Variables are not stored in the unique table, since each symbol keeps the
+ * ID of its VAR node.
+ */
 
-static Mgr *
-init (void)
+/* Final mixing step ('fmix32' of MurmurHash3).  References of nearby nodes
+ * differ in few bits only and would otherwise cluster in the table.
+ */
+static unsigned
+mix_hash (unsigned res)
 {
-  Mgr *res;
-
-  res = (Mgr *) malloc (sizeof (*res));
-  memset (res, 0, sizeof (*res));
-  res->nodes_size = 2;
-  res->nodes = (Node **) calloc (res->nodes_size, sizeof (Node *));
-  res->buffer_size = 2;
-  res->buffer = (char *) malloc (res->buffer_size);
-  res->in = stdin;
-  res->log = stderr;
-  res->out = stdout;
-
-  res->input_pos = 0;
+  res ^= res >> 16;
+  res *= 0x85ebca6bu;
+  res ^= res >> 13;
+  res *= 0xc2b2ae35u;
+  res ^= res >> 16;
 
   return res;
 }
 
 /*------------------------------------------------------------------------*/
 
-static void
-connect_solver (Mgr * mgr)
+static unsigned
+hash_op (Type type, Ref c0, Ref c1)
 {
-  assert (mgr->use_lingeling || mgr->use_picosat || mgr->use_depqbf);
-#ifdef LIMBOOLE_USE_PICOSAT
-  if (mgr->use_picosat)
-    {
-      assert (!mgr->picosat);
-      mgr->picosat = picosat_init ();
-      if (mgr->verbose)
-	picosat_set_verbosity (mgr->picosat, 1);
-      picosat_set_prefix (mgr->picosat, "c PicoSAT ");
-      picosat_set_output (mgr->picosat, mgr->log);
-    }
-#endif
-#ifdef LIMBOOLE_USE_LINGELING
-  if (mgr->use_lingeling)
-    {
-      assert (!mgr->lgl);
-      mgr->lgl = lglinit ();
-      if (mgr->verbose)
-        lglsetopt(mgr->lgl, "verbose", 1);
-      lglsetprefix(mgr->lgl, "c Lingeling ");
-      lglsetout(mgr->lgl, mgr->log);
-  }
-#endif
-#ifdef LIMBOOLE_USE_DEPQBF
-  if (mgr->use_depqbf)
-    {
-      assert (!mgr->qdpll);
-      mgr->qdpll = qdpll_create ();
-      qdpll_configure(mgr->qdpll, "--no-dynamic-nenofex");
-    }
-#endif
-  assert (mgr->lgl || mgr->picosat || mgr->qdpll);
+  unsigned res;
+
+  res = (unsigned) type;
+  res += 4017271 * c0;
+  res += 70200511 * c1;
+
+  return mix_hash (res);
 }
 
 /*------------------------------------------------------------------------*/
 
-static void
-release (Mgr * mgr)
+static unsigned
+hash_ite (Ref c, Ref t, Ref e)
 {
-  Node *p, *next;
-  PNode *pp, *pnext;
+  unsigned res;
 
-#ifdef LIMBOOLE_USE_PICOSAT
-  if (mgr->picosat)
-    picosat_reset (mgr->picosat);
-#endif
-#ifdef LIMBOOLE_USE_LINGELING
-  if (mgr->lgl)
-    lglrelease (mgr->lgl);
-#endif
-#ifdef LIMBOOLE_USE_DEPQBF
-  if (mgr->qdpll)
-    qdpll_delete (mgr->qdpll);
-#endif
+  res = (unsigned) ITE;
+  res += 4017271 * c;
+  res += 70200511 * t;
+  res += 1000000007 * e;
 
-  for (p = mgr->first; p; p = next)
-    {
-      next = p->next_inserted;
-      if (p->type == VAR)
-	free (p->data.as_name);
-      free (p);
-    }
-  for (pp = mgr->first_prefix; pp; pp = pnext) {
-    pnext = pp->next; 
-    free (pp); 
-  }
+  return mix_hash (res);
+}
 
+/*------------------------------------------------------------------------*/
+/* AND and OR nodes are commutative, thus their hash value does not depend
+ * on the order of their children.
+ */
+static unsigned
+hash_nary (Type type, Ref * refs, unsigned size)
+{
+  unsigned res, i;
 
-  if (mgr->close_in)
-    fclose (mgr->in);
-  if (mgr->close_out)
-    fclose (mgr->out);
-  if (mgr->close_log)
-    fclose (mgr->log);
+  res = (unsigned) type;
+  for (i = 0; i < size; i++)
+    res += mix_hash (refs[i]);
 
-  free (mgr->idx2node);
-  free (mgr->nodes);
-  free (mgr->buffer);
-  free (mgr);
+  return mix_hash (res);
 }
 
 /*------------------------------------------------------------------------*/
-
-static void
-print_token (Mgr * mgr)
+/* The children of cardinality constraints are a multiset, but they are
+ * kept in their original order, thus the hash value depends on it.
+ */
+static unsigned
+hash_cardinality (Type type, Ref * refs, unsigned size, unsigned k)
 {
-  switch (mgr->token)
-    {
-    case VAR:
-      fputs (mgr->buffer, mgr->log);
-      break;
-    case LP:
-      fputc ('(', mgr->log);
-      break;
-    case RP:
-      fputc (')', mgr->log);
-      break;
-    case NOT:
-      fputc ('!', mgr->log);
-      break;
-    case AND:
-      fputc ('&', mgr->log);
-      break;
-    case OR:
-      fputc ('|', mgr->log);
-      break;
-    case IMPLIES:
-      fputs ("->", mgr->log);
-      break;
-    case SEILPMI:
-      fputs ("<-", mgr->log);
-      break;
-    case IFF:
-      fputs ("<->", mgr->log);
-      break;
-    default:
-      assert (mgr->token == DONE);
-      fputs ("EOF", mgr->log);
-      break;
-    }
+  unsigned res, i;
+
+  res = (unsigned) type + 4017271 * k;
+  for (i = 0; i < size; i++)
+    res = 70200511 * res + refs[i];
+
+  return mix_hash (res);
 }
 
 /*------------------------------------------------------------------------*/
 
-static void
-parse_error (Mgr * mgr, const char *fmt, ...)
+static int
+is_nary (Type type)
 {
-  va_list ap;
-  char *name;
+  return type == AND || type == OR;
+}
 
-  name = mgr->name ? mgr->name : "<stdin>";
-  fprintf (mgr->log, "%s:%u:%u: ", name, mgr->token_x + 1, mgr->token_y);
-  if (mgr->token == ERROR)
-    fputs ("scan error: ", mgr->log);
-  else
-    {
-      fputs ("parse error at '", mgr->log);
-      print_token (mgr);
-      fputs ("' ", mgr->log);
-    }
-  va_start (ap, fmt);
-  vfprintf (mgr->log, fmt, ap);
-  va_end (ap);
-  fputc ('\n', mgr->log);
+/*------------------------------------------------------------------------*/
+
+static int
+is_cardinality (Type type)
+{
+  return type == ATMOST || type == ATLEAST || type == EXACTLY;
 }
 
 /*------------------------------------------------------------------------*/
 
 static int
-is_var_letter (int ch)
+is_marked (Mgr * mgr, Ref ref)
 {
-  if (isalnum (ch))
-    return 1;
+  return mgr->marks[node_id (ref)] & (1 << is_negated (ref));
+}
 
-  switch (ch)
-    {
-    case '-':
-    case '_':
-    case '.':
-    case '[':
-    case ']':
-    case '$':
-    case '@':
-      return 1;
+/*------------------------------------------------------------------------*/
+/* The children of the node under construction are marked, and since
+ * children are unique, comparing sizes and checking marks is enough.
+ */
+static int
+eq_nary (Mgr * mgr, unsigned id, Type type, unsigned size)
+{
+  Ref *p, *end;
 
-    default:
+  if (mgr->types[id] != type || mgr->child1[id] != size)
+    return 0;
+
+  p = mgr->refs + mgr->child0[id];
+  end = p + size;
+  while (p < end)
+    if (!is_marked (mgr, *p++))
       return 0;
-    }
+
+  return 1;
 }
 
 /*------------------------------------------------------------------------*/
-
-static void
-enlarge_buffer (Mgr * mgr)
+/* The children of the ITE node under construction are in 'children'.
+ */
+static int
+eq_ite (Mgr * mgr, unsigned id)
 {
-  mgr->buffer_size *= 2;
-  mgr->buffer = (char *) realloc (mgr->buffer, mgr->buffer_size);
+  Ref *refs;
+
+  if (mgr->types[id] != ITE)
+    return 0;
+
+  refs = mgr->refs + mgr->child0[id];
+
+  return refs[0] == mgr->children[0] && refs[1] == mgr->children[1]
+    && refs[2] == mgr->children[2];
 }
 
 /*------------------------------------------------------------------------*/
+/* The children of the cardinality node under construction followed by its
+ * bound are in 'children'.
+ */
+static int
+eq_cardinality (Mgr * mgr, unsigned id, Type type, unsigned size)
+{
+  if (mgr->types[id] != type || mgr->child1[id] != size)
+    return 0;
 
-static int next_char(Mgr *mgr) {
-  int res;
+  return !memcmp (mgr->refs + mgr->child0[id], mgr->children,
+		  (size + 1) * sizeof (Ref));
+}
 
-  mgr->last_y = mgr->y;
+/*------------------------------------------------------------------------*/
+/* For AND and OR nodes 'c1' is ignored and 'c0' is the number of marked
+ * children.  Both are ignored for ITE nodes.  For cardinality nodes 'c0'
+ * is the number of children.
+ */
+static int
+eq (Mgr * mgr, unsigned id, Type type, unsigned c0, unsigned c1)
+{
+  if (is_nary (type))
+    return eq_nary (mgr, id, type, c0);
 
-  if (mgr->saved_char_is_valid) {
-    mgr->saved_char_is_valid = 0;
-    res = mgr->saved_char;
-  } else {
-    if (mgr->input == NULL) {
-      res = fgetc(mgr->in);
-    } else {
-      if (mgr->input_pos == mgr->input_length)
-        return EOF;
-      res = mgr->input[mgr->input_pos++];
-    }
-  }
+  if (type == ITE)
+    return eq_ite (mgr, id);
 
-  if (res == '\n') {
-    mgr->x++;
-    mgr->y = 0;
-  } else
-    mgr->y++;
+  if (is_cardinality (type))
+    return eq_cardinality (mgr, id, type, c0);
 
-  return res;
+  return mgr->types[id] == type && mgr->child0[id] == c0
+    && mgr->child1[id] == c1;
 }
 
 /*------------------------------------------------------------------------*/
-
-static void
-unget_char (Mgr * mgr, int ch)
+/* Returns the slot with a matching node or the empty slot where such a node
+ * has to be inserted.
+ */
+static Slot *
+find (Mgr * mgr, unsigned h, Type type, unsigned c0, unsigned c1)
 {
-  assert (!mgr->saved_char_is_valid);
+  unsigned mask, i;
+  Slot *s;
 
-  mgr->saved_char_is_valid = 1;
-  mgr->saved_char = ch;
+  mask = mgr->table_size - 1;
+  for (i = h & mask; (s = mgr->table + i)->node; i = (i + 1) & mask)
+    if (s->hash == h && eq (mgr, s->node, type, c0, c1))
+      break;
 
-  if (ch == '\n')
-    {
-      mgr->x--;
-      mgr->y = mgr->last_y;
-    }
-  else
-    mgr->y--;
+  return s;
 }
 
 /*------------------------------------------------------------------------*/
 
 static void
-next_token (Mgr * mgr)
+resize_table (Mgr * mgr, unsigned new_size)
 {
-  int ch;
-
-  mgr->token = ERROR;
-  ch = next_char (mgr);
+  Slot *old_table, *p, *q;
+  unsigned old_table_size, mask, i;
 
-RESTART_NEXT_TOKEN:
+  assert (!(new_size & (new_size - 1)));
+  assert (new_size > 2 * mgr->table_count);
 
-  while (isspace ((int) ch))
-    ch = next_char (mgr);
+  old_table = mgr->table;
+  old_table_size = mgr->table_size;
+  mgr->table_size = new_size;
+  mgr->table = (Slot *) calloc (new_size, sizeof (Slot));
+  mask = new_size - 1;
 
-  if (ch == '%')
+  for (p = old_table; p < old_table + old_table_size; p++)
     {
-      while ((ch = next_char (mgr)) != '\n' && ch != EOF)
-	;
-
-      goto RESTART_NEXT_TOKEN;
-    }
+      if (!p->node)
+	continue;
 
-  mgr->token_x = mgr->x;
-  mgr->token_y = mgr->y;
-
-  if (ch == EOF)
-    mgr->token = DONE;
-  else if (ch == '<')
-    {
-      ch = next_char (mgr);
-      if (ch == '-')
-	{
-	  ch = next_char (mgr);
-	  if (ch == '>')
-	    mgr->token = IFF;
-	  else
-	    {
-	      unget_char (mgr, ch);
-	      mgr->token = SEILPMI;
-	    }
-	}
-      else
-	parse_error (mgr, "expected '-' after '<'");
-    }
-  else if (ch == '-')
-    {
-      ch = next_char (mgr);
-      if (ch == '>')
-	mgr->token = IMPLIES;
-      else
-	{
-	  unget_char (mgr, ch);
-	  mgr->token = NOT;
-	}
-    }
-  else if (ch == '&')
-    {
-      mgr->token = AND;
-    }
-  else if (ch == '?' && mgr->use_depqbf)
-    {
-      mgr->token = EX;
-    }
-  else if (ch == '#' && mgr->use_depqbf)
-    {
-      mgr->token = ALL;
-    }
-  else if (ch == '|' || ch == '/')
-    {
-      mgr->token = OR;
-    }
-  else if (ch == '!' || ch == '~')
-    {
-      mgr->token = NOT;
-    }
-  else if (ch == '(')
-    {
-      mgr->token = LP;
-    }
-  else if (ch == ')')
-    {
-      mgr->token = RP;
+      for (i = p->hash & mask; (q = mgr->table + i)->node; i = (i + 1) & mask)
+	;
+      *q = *p;
     }
-  else if (is_var_letter (ch))
-    {
-      mgr->buffer_count = 0;
 
-      while (is_var_letter (ch))
-	{
-	  if (mgr->buffer_size <= mgr->buffer_count + 1)
-	    enlarge_buffer (mgr);
-
-	  mgr->buffer[mgr->buffer_count++] = ch;
-	  ch = next_char (mgr);
-	}
-
-      unget_char (mgr, ch);
-      mgr->buffer[mgr->buffer_count] = 0;
+  free (old_table);
+}
 
-      if (mgr->buffer[mgr->buffer_count - 1] == '-')
-	parse_error (mgr, "variable '%s' ends with '-'", mgr->buffer);
-      else
-	mgr->token = VAR;
-    }
-  else
-    parse_error (mgr, "invalid character '%c'", ch);
+/*------------------------------------------------------------------------*/
+/* Keep the load factor of the unique table at most one half.
+ */
+static void
+enlarge_table (Mgr * mgr)
+{
+  if (2 * (mgr->table_count + 1) > mgr->table_size)
+    resize_table (mgr, 2 * mgr->table_size);
 }
 
 /*------------------------------------------------------------------------*/
 
-static Node *parse_expr (Mgr *);
+static void
+resize_nodes (Mgr * mgr, unsigned new_size)
+{
+  assert (new_size > mgr->nodes_count);
+
+  mgr->nodes_size = new_size;
+  mgr->types = (unsigned char *) realloc (mgr->types, new_size);
+  mgr->marks = (unsigned char *) realloc (mgr->marks, new_size);
+  mgr->child0 = (unsigned *) realloc (mgr->child0,
+				      new_size * sizeof (unsigned));
+  mgr->child1 = (unsigned *) realloc (mgr->child1,
+				      new_size * sizeof (unsigned));
+  mgr->idxs = (int *) realloc (mgr->idxs, new_size * sizeof (int));
+}
 
 /*------------------------------------------------------------------------*/
-
-static Node *
-parse_basic (Mgr * mgr)
+/* Grow the unique table and the node arrays in advance for the expected
+ * number of nodes.
+ */
+static void
+reserve_nodes (Mgr * mgr, size_t expected)
 {
-  Node *child;
-  Node *res;
+  unsigned size;
 
-  res = 0;
+  if (expected > (1u << 23))
+    expected = 1u << 23;
 
-  if (mgr->token == LP)
-    {
-      next_token (mgr);
-      child = parse_expr (mgr);
-      if (mgr->token != RP)
-	{
-	  if (mgr->token != ERROR)
-	    parse_error (mgr, "expected ')'");
-	}
-      else
-	res = child;
-      next_token (mgr);
-    }
-  else if (mgr->token == VAR)
-    {
-      res = var (mgr, mgr->buffer);
-      next_token (mgr);
-    }
-  else if (mgr->token != ERROR)
-    parse_error (mgr, "expected variable or '('");
+  size = mgr->table_size;
+  while (size < 2 * (expected + 1))
+    size *= 2;
 
-  return res;
+  if (size > mgr->table_size)
+    resize_table (mgr, size);
+
+  if (expected >= mgr->nodes_size)
+    resize_nodes (mgr, expected + 1);
 }
 
 /*------------------------------------------------------------------------*/
-
-static Node *
-parse_not (Mgr * mgr)
+/* Returns the ID of a new node, which is added to the unique table if
+ * 'slot' is not zero.  Variables have no slot.
+ */
+static unsigned
+new_node (Mgr * mgr, Slot * slot, unsigned h, Type type,
+	  unsigned c0, unsigned c1)
 {
-  Node *child, *res;
+  unsigned res;
+
+  if (mgr->nodes_count + 1 == mgr->nodes_size)
+    resize_nodes (mgr, 2 * mgr->nodes_size);
 
-  if (mgr->token == NOT)
+  res = ++mgr->nodes_count;
+  mgr->types[res] = type;
+  mgr->marks[res] = 0;
+  mgr->child0[res] = c0;
+  mgr->child1[res] = c1;
+  mgr->idxs[res] = 0;
+
+  if (slot)
     {
-      next_token (mgr);
-      child = parse_not (mgr);
-      if (child)
-	res = op (mgr, NOT, child, 0);
-      else
-	res = 0;
+      slot->hash = h;
+      slot->node = res;
+      mgr->table_count++;
     }
-  else
-    res = parse_basic (mgr);
 
   return res;
 }
 
 /*------------------------------------------------------------------------*/
 
-static Node *
-parse_associative_op (Mgr * mgr, Type type, Node * (*lower) (Mgr *))
+static Ref
+var (Mgr * mgr, unsigned symbol)
 {
-  Node *res, *child;
-  int done;
-
-  res = 0;
-  done = 0;
+  Symbol *s;
 
-  do
-    {
-      child = lower (mgr);
-      if (child)
-	{
-	  res = res ? op (mgr, type, res, child) : child;
-	  if (mgr->token == type)
-	    next_token (mgr);
-	  else
-	    done = 1;
-	}
-      else
-	res = 0;
-    }
-  while (res && !done);
+  assert (symbol < mgr->symbols_count);
+  s = mgr->symbols + symbol;
+  if (!s->node)
+    s->node = new_node (mgr, 0, 0, VAR, symbol, 0);
 
-  return res;
+  return s->node << 1;
 }
 
-
 /*------------------------------------------------------------------------*/
 
-static Node *
-parse_and (Mgr * mgr)
+/* The constant FALSE node is only created when needed, thus it does not
+ * take a variable in formulas without constants.  TRUE is its negation.
+ */
+static Ref
+constant (Mgr * mgr)
 {
-  return parse_associative_op (mgr, AND, parse_not);
+  if (!mgr->constant)
+    mgr->constant = new_node (mgr, 0, 0, FALSE, 0, 0);
+
+  return mgr->constant << 1;
 }
 
 /*------------------------------------------------------------------------*/
 
-static Node *
-parse_or (Mgr * mgr)
+static int
+is_constant (Mgr * mgr, Ref ref)
 {
-  return parse_associative_op (mgr, OR, parse_and);
+  return node_id (ref) == mgr->constant;
 }
 
 /*------------------------------------------------------------------------*/
 
-static Node *
-parse_implies (Mgr * mgr)
+static int
+cmp_refs (const void *p, const void *q)
 {
-  Node *l, *r;
-  Type token;
-
-  if (!(l = parse_or (mgr)))
-    return 0;
-  token = mgr->token;
-  if (token != IMPLIES && token != SEILPMI)
-    return l;
-  next_token (mgr);
-  if (!(r = parse_or (mgr)))
-    return 0;
+  Ref a, b;
 
-  return op (mgr, token, l, r);
-}
-
-/*------------------------------------------------------------------------*/
+  a = *(const Ref *) p;
+  b = *(const Ref *) q;
 
-static Node *
-parse_iff (Mgr * mgr)
-{
-  return parse_associative_op (mgr, IFF, parse_implies);
+  return a < b ? -1 : a > b;
 }
 
 /*------------------------------------------------------------------------*/
 
-#ifdef LIMBOOLE_USE_DEPQBF
-static int parse_prefix(Mgr *mgr) {
-  Type token;
-  Node *v;
-  PNode *p, *n = NULL;
-
-  int scope = EX;
+static Ref nary (Mgr *, Type, Ref *, unsigned);
 
-  if (mgr->token == ERROR)
-    return 0;
+/* With 'simplify' implications are built as negated conjunctions, and
+ * equivalences have unnegated children in increasing order, a negated
+ * reference instead, and the following rules are applied:
+ *
+ *   a <-> a  =  TRUE        a <-> TRUE   =  a
+ *   a <-> !a =  FALSE       a <-> FALSE  =  !a
+ */
+static Ref
+op (Mgr * mgr, Type type, Ref c0, Ref c1)
+{
+  Ref children[2], sign, tmp;
+  unsigned h;
+  Slot *p;
 
-  int outer_scope_quantor =
-    mgr->check_satisfiability == 1 ? QDPLL_QTYPE_EXISTS : QDPLL_QTYPE_FORALL;
+  if (type == NOT)
+    return negate (c0);
 
-  mgr->outer = mgr->inner = qdpll_new_scope(mgr->qdpll, outer_scope_quantor);
-  while ((mgr->token == ALL) || (mgr->token == EX)) {
-    token = mgr->token;
-    next_token(mgr);
-    if (mgr->token != VAR)
-      return 0;
-    v = var(mgr, mgr->buffer);
-    v->idx = ++mgr->idx;
-    p = (PNode *)malloc(sizeof(*p));
-    p->node = v;
-    p->type = mgr->token;
-    p->next = NULL;
-    if (n) {
-      n->next = p;
-    } else {
-      mgr->first_prefix = n = p;
+  if (is_nary (type))
+    {
+      children[0] = c0;
+      children[1] = c1;
+      return nary (mgr, type, children, 2);
     }
-    n = p;
-
-    if (scope != token) {
 
-      if (scope)
-        qdpll_add(mgr->qdpll, 0);
+  if (mgr->simplify && type == IMPLIES)
+    return negate (op (mgr, AND, c0, negate (c1)));
+  if (mgr->simplify && type == SEILPMI)
+    return negate (op (mgr, AND, negate (c0), c1));
 
-      mgr->inner = qdpll_new_scope(
-          mgr->qdpll, token == ALL ? QDPLL_QTYPE_FORALL : QDPLL_QTYPE_EXISTS);
-      scope = token;
+  sign = 0;
+  if (mgr->simplify && type == IFF)
+    {
+      sign = is_negated (c0) ^ is_negated (c1);
+      c0 &= ~1u;
+      c1 &= ~1u;
+      if (c0 > c1)
+	{
+	  tmp = c0;
+	  c0 = c1;
+	  c1 = tmp;
+	}
+      if (c0 == c1)
+	return negate (constant (mgr)) ^ sign;
+      if (is_constant (mgr, c0))
+	return negate (c1) ^ sign;
+      if (is_constant (mgr, c1))
+	return negate (c0) ^ sign;
     }
-    qdpll_add(mgr->qdpll, v->idx);
 
-    next_token(mgr);
-  }
-  if (scope)
-    qdpll_add(mgr->qdpll, 0);
+  enlarge_table (mgr);
 
-  if (scope == ALL) {
-    mgr->inner = qdpll_new_scope(mgr->qdpll, QDPLL_QTYPE_EXISTS);
-    qdpll_add(mgr->qdpll, 0);
-  }
+  h = hash_op (type, c0, c1);
+  p = find (mgr, h, type, c0, c1);
+  if (p->node)
+    return (p->node << 1) ^ sign;
 
-  return 1;
+  return (new_node (mgr, p, h, type, c0, c1) << 1) ^ sign;
 }
-#endif
 
 /*------------------------------------------------------------------------*/
-
-static Node *
-parse_expr (Mgr * mgr)
+/* A negated conjunction '!(... & !c & ...)', i.e. a disjunction containing
+ * 'c', is implied by a sibling 'c' and dropped.  Children of the
+ * conjunction under construction are marked.
+ */
+static unsigned
+absorb (Mgr * mgr, Ref * unique, unsigned size)
 {
-  return parse_iff (mgr);
+  unsigned i, j, k, id, n;
+  Ref *refs;
+
+  for (i = j = 0; i < size; i++)
+    {
+      id = node_id (unique[i]);
+      if (is_negated (unique[i]) && mgr->types[id] == AND)
+	{
+	  refs = mgr->refs + mgr->child0[id];
+	  n = mgr->child1[id];
+	  for (k = 0; k < n; k++)
+	    if (is_marked (mgr, negate (refs[k])))
+	      break;
+	  if (k < n)
+	    {
+	      mgr->marks[id] = 0;
+	      continue;
+	    }
+	}
+      unique[j++] = unique[i];
+    }
+
+  return j;
 }
 
 /*------------------------------------------------------------------------*/
-
+/* Recognize '!(c & t) & !(!c & e)', which is '!(c ? t : e)'.
+ */
 static int
-parse (Mgr * mgr)
+is_mux (Mgr * mgr, Ref * refs, Ref * mux)
 {
-  if (mgr->token == ERROR)
-    return 0;
+  unsigned i, k, x, y;
+  Ref *xs, *ys;
 
-  if (!(mgr->root = parse_expr (mgr)))
+  if (!is_negated (refs[0]) || !is_negated (refs[1]))
     return 0;
 
-  if (mgr->token == DONE)
-    return 1;
+  x = node_id (refs[0]);
+  y = node_id (refs[1]);
+  if (mgr->types[x] != AND || mgr->child1[x] != 2
+      || mgr->types[y] != AND || mgr->child1[y] != 2)
+    return 0;
 
-  if (mgr->token != ERROR)
-    parse_error (mgr, "expected operator or EOF");
+  xs = mgr->refs + mgr->child0[x];
+  ys = mgr->refs + mgr->child0[y];
+  for (i = 0; i < 2; i++)
+    for (k = 0; k < 2; k++)
+      if (xs[i] == negate (ys[k]))
+	{
+	  mux[0] = xs[i];
+	  mux[1] = xs[!i];
+	  mux[2] = ys[!k];
+	  return 1;
+	}
 
   return 0;
 }
 
 /*------------------------------------------------------------------------*/
 
-static void
-add_lit (Mgr * mgr, int lit)
+static Ref ite (Mgr *, Ref, Ref, Ref);
+
+/*------------------------------------------------------------------------*/
+/* Conjunctions and disjunctions have an arbitrary number of children.
+ * Duplicated children are removed, and the unique table compares children
+ * as sets, so 'a & b' and 'b & a' share one node.  Otherwise children stay
+ * in the order of their first occurrence to keep pretty printing faithful.
+ * Children of all AND, OR and ITE nodes are stored consecutively in 'refs'.
+ *
+ * With 'simplify' only conjunctions are built, and disjunctions become
+ * negated conjunctions.  Their children are sorted, absorbed children are
+ * dropped, and constants are folded:
+ *
+ *   a & TRUE  =  a          a & !a          =  FALSE
+ *   a & FALSE =  FALSE      a & (a | b)     =  a
+ *
+ * and multiplexers '(c & t) | (!c & e)' become ITE nodes.
+ */
+static Ref
+nary (Mgr * mgr, Type type, Ref * refs, unsigned size)
 {
-#ifdef LIMBOOLE_USE_PICOSAT
-  if (mgr->picosat)
-    picosat_add (mgr->picosat, lit);
-#endif
+  Ref res, *unique, mux[3], ref, sign;
+  unsigned h, i, j, id;
+  Slot *p;
+
+  assert (is_nary (type));
+  assert (size > 0);
+
+  enlarge_table (mgr);
+
+  if (mgr->children_size < size)
+    {
+      mgr->children_size = size;
+      mgr->children = (Ref *) realloc (mgr->children,
+				       size * sizeof (Ref));
+    }
+
+  sign = 0;
+  if (mgr->simplify && type == OR)
+    {
+      sign = 1;
+      type = AND;
+    }
+
+  unique = mgr->children;
+  res = 0;
+  for (i = j = 0; i < size; i++)
+    {
+      ref = refs[i] ^ sign;
+      if (mgr->simplify && is_constant (mgr, ref))
+	{
+	  if (is_negated (ref))
+	    continue;
+	  res = ref;
+	  break;
+	}
+      if (mgr->simplify && is_marked (mgr, negate (ref)))
+	{
+	  res = constant (mgr);
+	  break;
+	}
+      if (!is_marked (mgr, ref))
+	{
+	  mgr->marks[node_id (ref)] |= 1 << is_negated (ref);
+	  unique[j++] = ref;
+	}
+    }
+
+  if (!res && mgr->simplify)
+    {
+      j = absorb (mgr, unique, j);
+      qsort (unique, j, sizeof (Ref), cmp_refs);
+    }
+
+  h = 0;
+  p = 0;
+  mux[0] = 0;
+
+  if (res)
+    ;
+  else if (!j)
+    res = negate (constant (mgr));
+  else if (j == 1)
+    res = unique[0];
+  else if (mgr->simplify && j == 2 && is_mux (mgr, unique, mux))
+    ;
+  else
+    {
+      h = hash_nary (type, unique, j);
+      p = find (mgr, h, type, j, 0);
+      res = p->node << 1;
+    }
+
+  for (i = 0; i < j; i++)
+    mgr->marks[node_id (unique[i])] = 0;
+
+  if (mux[0])
+    return negate (ite (mgr, mux[0], mux[1], mux[2])) ^ sign;
+
+  if (res)
+    return res ^ sign;
+
+  while (mgr->refs_size - mgr->refs_count < j)
+    {
+      mgr->refs_size = mgr->refs_size ? 2 * mgr->refs_size : 16;
+      mgr->refs = (Ref *) realloc (mgr->refs, mgr->refs_size * sizeof (Ref));
+    }
+
+  memcpy (mgr->refs + mgr->refs_count, unique, j * sizeof (Ref));
+  id = new_node (mgr, p, h, type, (unsigned) mgr->refs_count, j);
+  mgr->refs_count += j;
+
+  return (id << 1) ^ sign;
+}
+
+/*------------------------------------------------------------------------*/
+/* If-then-else nodes 'c ? t : e' have their three children in 'refs'.  With
+ * 'simplify' the condition and the then-branch are unnegated, by swapping
+ * the branches and negating the node, and the following rules are applied:
+ *
+ *   c ? t : t      =  t          c ? t : !t     =  c <-> t
+ *   FALSE ? t : e  =  e          c ? c : e      =  c | e
+ *   c ? FALSE : e  =  !c & e     c ? t : c      =  c & t
+ *   c ? t : FALSE  =  c & t      c ? t : !c     =  !c | t
+ *   c ? t : TRUE   =  !c | t
+ */
+static Ref
+ite (Mgr * mgr, Ref c, Ref t, Ref e)
+{
+  Ref sign, tmp;
+  unsigned h, id;
+  Slot *p;
+
+  sign = 0;
+  if (mgr->simplify)
+    {
+      if (is_negated (c))
+	{
+	  c = negate (c);
+	  tmp = t;
+	  t = e;
+	  e = tmp;
+	}
+      if (t == e)
+	return t;
+      if (is_constant (mgr, c))
+	return e;
+      if (is_negated (t))
+	{
+	  sign = 1;
+	  t = negate (t);
+	  e = negate (e);
+	}
+      if (t == negate (e))
+	return op (mgr, IFF, c, t) ^ sign;
+      if (is_constant (mgr, t))
+	return op (mgr, AND, negate (c), e) ^ sign;
+      if (is_constant (mgr, e))
+	return (is_negated (e) ? negate (op (mgr, AND, c, negate (t)))
+		: op (mgr, AND, c, t)) ^ sign;
+      if (t == c)
+	return negate (op (mgr, AND, negate (c), negate (e))) ^ sign;
+      if (e == c)
+	return op (mgr, AND, c, t) ^ sign;
+      if (e == negate (c))
+	return negate (op (mgr, AND, c, negate (t))) ^ sign;
+    }
+
+  enlarge_table (mgr);
+
+  if (mgr->children_size < 3)
+    {
+      mgr->children_size = 3;
+      mgr->children = (Ref *) realloc (mgr->children, 3 * sizeof (Ref));
+    }
+
+  mgr->children[0] = c;
+  mgr->children[1] = t;
+  mgr->children[2] = e;
+
+  h = hash_ite (c, t, e);
+  p = find (mgr, h, ITE, 0, 0);
+  if (p->node)
+    return (p->node << 1) ^ sign;
+
+  while (mgr->refs_size - mgr->refs_count < 3)
+    {
+      mgr->refs_size = mgr->refs_size ? 2 * mgr->refs_size : 16;
+      mgr->refs = (Ref *) realloc (mgr->refs, mgr->refs_size * sizeof (Ref));
+    }
+
+  memcpy (mgr->refs + mgr->refs_count, mgr->children, 3 * sizeof (Ref));
+  id = new_node (mgr, p, h, ITE, (unsigned) mgr->refs_count, 3);
+  mgr->refs_count += 3;
+
+  return (id << 1) ^ sign;
+}
+
+/*------------------------------------------------------------------------*/
+static Ref expand_cardinality (Mgr *, Type, unsigned, Ref *, unsigned);
+
+/* Cardinality constraints 'atmost', 'atleast' and 'exactly' with bound 'k'
+ * over 'size' children.  They are kept as parsed for pretty printing and
+ * compiling, and 'normalize' replaces them by counters.  With 'simplify'
+ * they are replaced right away.
+ */
+static Ref
+cardinality (Mgr * mgr, Type type, unsigned k, Ref * refs, unsigned size)
+{
+  unsigned h, id;
+  Slot *p;
+
+  assert (is_cardinality (type));
+  assert (size > 0);
+
+  if (mgr->simplify)
+    return expand_cardinality (mgr, type, k, refs, size);
+
+  enlarge_table (mgr);
+
+  if (mgr->children_size < size + 1)
+    {
+      mgr->children_size = size + 1;
+      mgr->children = (Ref *) realloc (mgr->children,
+				       (size + 1) * sizeof (Ref));
+    }
+
+  memcpy (mgr->children, refs, size * sizeof (Ref));
+  mgr->children[size] = k;
+
+  h = hash_cardinality (type, refs, size, k);
+  p = find (mgr, h, type, size, 0);
+  if (p->node)
+    return p->node << 1;
+
+  while (mgr->refs_size - mgr->refs_count < size + 1)
+    {
+      mgr->refs_size = mgr->refs_size ? 2 * mgr->refs_size : 16;
+      mgr->refs = (Ref *) realloc (mgr->refs, mgr->refs_size * sizeof (Ref));
+    }
+
+  memcpy (mgr->refs + mgr->refs_count, mgr->children,
+	  (size + 1) * sizeof (Ref));
+  id = new_node (mgr, p, h, type, (unsigned) mgr->refs_count, size);
+  mgr->refs_count += size + 1;
+
+  return id << 1;
+}
+
+/*------------------------------------------------------------------------*/
+
+static Mgr *
+init (void)
+{
+  Mgr *res;
+
+  res = (Mgr *) malloc (sizeof (*res));
+  memset (res, 0, sizeof (*res));
+  res->table_size = 16;
+  res->table = (Slot *) calloc (res->table_size, sizeof (Slot));
+  resize_nodes (res, 16);
+  res->types[0] = DONE;		/* node ID zero is invalid */
+  res->in = stdin;
+  res->log = stderr;
+  res->out = stdout;
+
+  res->input_pos = 0;
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+connect_solver (Mgr * mgr)
+{
+  assert (mgr->use_lingeling || mgr->use_picosat || mgr->use_depqbf);
+#ifdef LIMBOOLE_USE_PICOSAT
+  if (mgr->use_picosat)
+    {
+      assert (!mgr->picosat);
+      mgr->picosat = picosat_init ();
+      if (mgr->verbose)
+	picosat_set_verbosity (mgr->picosat, 1);
+      picosat_set_prefix (mgr->picosat, "c PicoSAT ");
+      picosat_set_output (mgr->picosat, mgr->log);
+    }
+#endif
+#ifdef LIMBOOLE_USE_LINGELING
+  if (mgr->use_lingeling)
+    {
+      assert (!mgr->lgl);
+      mgr->lgl = lglinit ();
+      if (mgr->verbose)
+        lglsetopt(mgr->lgl, "verbose", 1);
+      lglsetprefix(mgr->lgl, "c Lingeling ");
+      lglsetout(mgr->lgl, mgr->log);
+  }
+#endif
+#ifdef LIMBOOLE_USE_DEPQBF
+  if (mgr->use_depqbf)
+    {
+      assert (!mgr->qdpll);
+      mgr->qdpll = qdpll_create ();
+      qdpll_configure(mgr->qdpll, "--no-dynamic-nenofex");
+    }
+#endif
+  assert (mgr->lgl || mgr->picosat || mgr->qdpll);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+release (Mgr * mgr)
+{
+  PNode *pp, *pnext;
+
+#ifdef LIMBOOLE_USE_PICOSAT
+  if (mgr->picosat)
+    picosat_reset (mgr->picosat);
+#endif
 #ifdef LIMBOOLE_USE_LINGELING
   if (mgr->lgl)
-    lgladd (mgr->lgl, lit);
+    lglrelease (mgr->lgl);
 #endif
 #ifdef LIMBOOLE_USE_DEPQBF
   if (mgr->qdpll)
-    qdpll_add(mgr->qdpll, lit);
+    qdpll_delete (mgr->qdpll);
+#endif
+
+  for (pp = mgr->first_prefix; pp; pp = pnext) {
+    pnext = pp->next; 
+    free (pp); 
+  }
+
+
+  if (mgr->close_in)
+    fclose (mgr->in);
+  if (mgr->close_out)
+    fclose (mgr->out);
+  if (mgr->close_log)
+    fclose (mgr->log);
+  if (mgr->dag)
+    fclose (mgr->dag);
+
+#ifdef LIMBOOLE_USE_MMAP
+  if (mgr->input_mapped)
+    munmap (mgr->input, mgr->input_length);
+#endif
+  if (mgr->input_owned)
+    free (mgr->input);
+
+  free (mgr->idx2node);
+  free (mgr->polarity);
+  free (mgr->batch.lits);
+  free (mgr->cnf.lits);
+  free (mgr->dump_buffer);
+  free (mgr->conjuncts);
+  free (mgr->xors.lits);
+  free (mgr->leaves);
+  free (mgr->children);
+  free (mgr->table);
+  free (mgr->types);
+  free (mgr->marks);
+  free (mgr->child0);
+  free (mgr->child1);
+  free (mgr->idxs);
+  free (mgr->refs);
+  free (mgr->symbols);
+  free (mgr->symtab);
+  free (mgr->pool);
+  free (mgr);
+}
+
+
+/*------------------------------------------------------------------------*/
+
+static void
+print_token (Mgr * mgr)
+{
+  switch (mgr->token)
+    {
+    case VAR:
+      fputs (symbol_name (mgr, mgr->symbol), mgr->log);
+      break;
+    case LP:
+      fputc ('(', mgr->log);
+      break;
+    case RP:
+      fputc (')', mgr->log);
+      break;
+    case NOT:
+      fputc ('!', mgr->log);
+      break;
+    case AND:
+      fputc ('&', mgr->log);
+      break;
+    case OR:
+      fputc ('|', mgr->log);
+      break;
+    case IMPLIES:
+      fputs ("->", mgr->log);
+      break;
+    case SEILPMI:
+      fputs ("<-", mgr->log);
+      break;
+    case IFF:
+      fputs ("<->", mgr->log);
+      break;
+    case EX:
+      fputc ('?', mgr->log);
+      break;
+    case ALL:
+      fputc ('#', mgr->log);
+      break;
+    case COLON:
+      fputc (':', mgr->log);
+      break;
+    case COMMA:
+      fputc (',', mgr->log);
+      break;
+    case SEMI:
+      fputc (';', mgr->log);
+      break;
+    case NUMBER:
+      fprintf (mgr->log, "%.*s", (int) mgr->digits_length, mgr->digits);
+      break;
+    default:
+      assert (mgr->token == DONE);
+      fputs ("EOF", mgr->log);
+      break;
+    }
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+parse_error (Mgr * mgr, const char *fmt, ...)
+{
+  va_list ap;
+  char *name;
+
+  if (!mgr->log)		/* parsing in a worker thread */
+    return;
+
+  name = mgr->name ? mgr->name : "<stdin>";
+  fprintf (mgr->log, "%s:%u:%u: ", name, mgr->token_x + 1, mgr->token_y);
+  if (mgr->token == ERROR)
+    fputs ("scan error: ", mgr->log);
+  else
+    {
+      fputs ("parse error at '", mgr->log);
+      print_token (mgr);
+      fputs ("' ", mgr->log);
+    }
+  va_start (ap, fmt);
+  vfprintf (mgr->log, fmt, ap);
+  va_end (ap);
+  fputc ('\n', mgr->log);
+}
+
+/*------------------------------------------------------------------------*/
+
+/* The whole input is lexed out of one contiguous buffer.  Files given on
+ * the command line are mapped into memory if possible, everything else
+ * (in particular <stdin>) is read in large blocks.  This avoids going
+ * through the locked 'fgetc' for every single character.
+ */
+static int
+load_input (Mgr * mgr)
+{
+  size_t size, bytes;
+  char *buffer;
+#ifdef LIMBOOLE_USE_MMAP
+  struct stat st;
+  void *mapped;
+
+  if (!fstat (fileno (mgr->in), &st) && S_ISREG (st.st_mode) && st.st_size > 0
+      && (size_t) st.st_size == (unsigned long long) st.st_size)
+    {
+      mapped = mmap (0, (size_t) st.st_size, PROT_READ, MAP_PRIVATE,
+		     fileno (mgr->in), 0);
+      if (mapped != MAP_FAILED)
+	{
+#ifdef MADV_SEQUENTIAL
+	  madvise (mapped, (size_t) st.st_size, MADV_SEQUENTIAL);
 #endif
+	  mgr->input = (char *) mapped;
+	  mgr->input_length = (size_t) st.st_size;
+	  mgr->input_mapped = 1;
+	  if (mgr->verbose)
+	    fprintf (mgr->log, "c mapped %llu bytes\n",
+		     (unsigned long long) mgr->input_length);
+	  return 1;
+	}
+    }
+#endif
+  size = 1 << 16;
+  buffer = (char *) malloc (size);
+  mgr->input_length = 0;
+
+  while ((bytes = fread (buffer + mgr->input_length, 1,
+			 size - mgr->input_length, mgr->in)))
+    {
+      mgr->input_length += bytes;
+      if (mgr->input_length == size)
+	{
+	  size *= 2;
+	  buffer = (char *) realloc (buffer, size);
+	}
+    }
+
+  mgr->input = buffer;
+  mgr->input_owned = 1;
+
+  if (ferror (mgr->in))
+    return 0;
+
+  if (mgr->verbose)
+    fprintf (mgr->log, "c read %llu bytes\n",
+	     (unsigned long long) mgr->input_length);
+
+  return 1;
+}
+
+/*------------------------------------------------------------------------*/
+
+/* Character classes of the lexer indexed by unsigned characters.  They
+ * agree with 'isalnum' and 'isspace' in the "C" locale.
+ */
+#define VAR_LETTER 1
+#define SPACE 2
+
+static const unsigned char char_class[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  2, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 0, 1,
+  0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+/*------------------------------------------------------------------------*/
+#ifdef LEXER_BLOCK
+/* Classify 'LEXER_BLOCK' characters at once.  Bit 'i' of the result is set
+ * iff 'p[i]' belongs to the class.  Signed byte comparison is fine, since
+ * all characters of interest are below 128.
+ */
+#define IN_RANGE(b,lo,hi) \
+  BLOCK_AND (BLOCK_GT (b, BLOCK_SET1 ((lo) - 1)), \
+	     BLOCK_GT (BLOCK_SET1 ((hi) + 1), b))
+
+static unsigned
+var_letter_mask (const unsigned char *p)
+{
+  Block b, res;
+
+  b = BLOCK_LOAD (p);
+  res = IN_RANGE (b, '-', '.');
+  res = BLOCK_OR (res, IN_RANGE (b, '0', '9'));
+  res = BLOCK_OR (res, IN_RANGE (b, '@', '['));	/* '@', 'A' - 'Z', '[' */
+  res = BLOCK_OR (res, IN_RANGE (b, 'a', 'z'));
+  res = BLOCK_OR (res, BLOCK_EQ (b, BLOCK_SET1 (']')));
+  res = BLOCK_OR (res, BLOCK_EQ (b, BLOCK_SET1 ('_')));
+  res = BLOCK_OR (res, BLOCK_EQ (b, BLOCK_SET1 ('$')));
+
+  return BLOCK_MASK (res);
+}
+
+/*------------------------------------------------------------------------*/
+
+static unsigned
+space_mask (const unsigned char *p, unsigned *newlines)
+{
+  Block b, res;
+
+  b = BLOCK_LOAD (p);
+  res = IN_RANGE (b, '\t', '\r');
+  res = BLOCK_OR (res, BLOCK_EQ (b, BLOCK_SET1 (' ')));
+  *newlines = BLOCK_MASK (BLOCK_EQ (b, BLOCK_SET1 ('\n')));
+
+  return BLOCK_MASK (res);
+}
+
+#endif
+/*------------------------------------------------------------------------*/
+
+static const unsigned char *
+scan_var (const unsigned char *p, const unsigned char *end)
+{
+#ifdef LEXER_BLOCK
+  unsigned mask;
+
+  while (end - p >= LEXER_BLOCK)
+    {
+      mask = ~var_letter_mask (p) & BLOCK_ALL;
+      if (mask)
+	return p + __builtin_ctz (mask);
+      p += LEXER_BLOCK;
+    }
+#endif
+  while (p < end && (char_class[*p] & VAR_LETTER))
+    p++;
+
+  return p;
+}
+
+/*------------------------------------------------------------------------*/
+/* Skip white space.  Every character increases the column 'y', while a new
+ * line increases the line 'x' and resets 'y'.
+ */
+static const unsigned char *
+skip_space (Mgr * mgr, const unsigned char *p, const unsigned char *end)
+{
+#ifdef LEXER_BLOCK
+  unsigned mask, newlines;
+  int n;
+
+  while (end - p >= LEXER_BLOCK)
+    {
+      mask = ~space_mask (p, &newlines) & BLOCK_ALL;
+      n = mask ? __builtin_ctz (mask) : LEXER_BLOCK;
+      if (n < LEXER_BLOCK)
+	newlines &= (1u << n) - 1;
+      if (newlines)
+	{
+	  mgr->x += __builtin_popcount (newlines);
+	  mgr->y = n - 1 - (31 - __builtin_clz (newlines));
+	}
+      else
+	mgr->y += n;
+      p += n;
+      if (mask)
+	return p;
+    }
+#endif
+  while (p < end && (char_class[*p] & SPACE))
+    {
+      if (*p++ == '\n')
+	{
+	  mgr->x++;
+	  mgr->y = 0;
+	}
+      else
+	mgr->y++;
+    }
+
+  return p;
+}
+
+/*------------------------------------------------------------------------*/
+/* Digits are letters of variables, thus the bound of a cardinality
+ * constraint is scanned like a variable but not interned.
+ */
+static void
+lex_number (Mgr * mgr, const char *name, size_t len)
+{
+  const char *error;
+  unsigned res;
+  size_t i;
+
+  mgr->token = NUMBER;
+  mgr->digits = name;
+  mgr->digits_length = len;
+
+  res = 0;
+  error = 0;
+  for (i = 0; !error && i < len; i++)
+    if (name[i] < '0' || name[i] > '9')
+      error = "expected number";
+    else if (res > (UINT_MAX - 9) / 10)
+      error = "number too large";
+    else
+      res = 10 * res + (name[i] - '0');
+
+  if (error)
+    {
+      parse_error (mgr, "%s", error);
+      mgr->token = ERROR;
+    }
+  else
+    mgr->number = res;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+next_token (Mgr * mgr)
+{
+  const unsigned char *p, *q, *end;
+  const char *name;
+  size_t len;
+  int ch;
+
+  mgr->token = ERROR;
+
+  p = (const unsigned char *) mgr->input + mgr->input_pos;
+  end = (const unsigned char *) mgr->input + mgr->input_length;
+
+  for (;;)
+    {
+      p = skip_space (mgr, p, end);
+      if (p == end || *p != '%')
+	break;
+
+      if ((q = memchr (p, '\n', end - p)))
+	{
+	  mgr->x++;
+	  mgr->y = 0;
+	  p = q + 1;
+	}
+      else
+	{
+	  mgr->y += end - p;
+	  p = end;
+	}
+    }
+
+  mgr->token_x = mgr->x;
+  mgr->token_y = ++mgr->y;
+
+  if (p == end)
+    {
+      mgr->token = DONE;
+      return;
+    }
+
+  ch = *p++;
+
+  if (ch == '<')
+    {
+      if (p < end && *p == '-')
+	{
+	  p++, mgr->y++;
+	  if (p < end && *p == '>')
+	    {
+	      p++, mgr->y++;
+	      mgr->token = IFF;
+	    }
+	  else
+	    mgr->token = SEILPMI;
+	}
+      else
+	{
+	  if (p < end && *p++ == '\n')
+	    {
+	      mgr->x++;
+	      mgr->y = 0;
+	    }
+	  else
+	    mgr->y++;
+	  parse_error (mgr, "expected '-' after '<'");
+	}
+    }
+  else if (ch == '-')
+    {
+      if (p < end && *p == '>')
+	{
+	  p++, mgr->y++;
+	  mgr->token = IMPLIES;
+	}
+      else
+	mgr->token = NOT;
+    }
+  else if (ch == '&')
+    {
+      mgr->token = AND;
+    }
+  else if (ch == '?')
+    {
+      mgr->token = EX;
+    }
+  else if (ch == ':')
+    {
+      mgr->token = COLON;
+    }
+  else if (ch == ',' && mgr->cardinalities)
+    {
+      mgr->token = COMMA;
+    }
+  else if (ch == ';' && mgr->cardinalities)
+    {
+      mgr->token = SEMI;
+    }
+  else if (ch == '#' && mgr->use_depqbf)
+    {
+      mgr->token = ALL;
+    }
+  else if (ch == '|' || ch == '/')
+    {
+      mgr->token = OR;
+    }
+  else if (ch == '!' || ch == '~')
+    {
+      mgr->token = NOT;
+    }
+  else if (ch == '(')
+    {
+      mgr->token = LP;
+    }
+  else if (ch == ')')
+    {
+      mgr->token = RP;
+    }
+  else if (char_class[ch] & VAR_LETTER)
+    {
+      /* Find the end of the variable first and then hash it, while it is
+       * still in the cache, and look it up in the symbol table.
+       */
+      q = scan_var (p, end);
+      len = q - p + 1;
+      mgr->y += len - 1;
+      name = (const char *) p - 1;
+      p = q;
+
+      if (name[len - 1] == '-')
+	parse_error (mgr, "variable '%.*s' ends with '-'", (int) len, name);
+      else if (mgr->bound)
+	lex_number (mgr, name, len);
+      else
+	{
+	  mgr->symbol = intern (mgr, name, len, hash_name (name, len));
+	  mgr->token = VAR;
+	}
+    }
+  else
+    parse_error (mgr, "invalid character '%c'", ch);
+
+  mgr->input_pos = p - (const unsigned char *) mgr->input;
+}
+
+/*------------------------------------------------------------------------*/
+
+#ifdef LIMBOOLE_USE_DEPQBF
+/* Declare the quantifier prefix to DepQBF.  Prefix variables get the first
+ * Tseitin indices in the order of the prefix.  Without solver instance,
+ * i.e. for '-d', only the indices are assigned.
+ */
+static void declare_prefix(Mgr *mgr) {
+  PNode *p;
+  int lit;
+
+  int scope = EX;
+
+  if (!mgr->qdpll) {
+    for (p = mgr->first_prefix; p; p = p->next)
+      mgr->idxs[p->node] = ++mgr->idx;
+    return;
+  }
+
+  int outer_scope_quantor =
+    mgr->check_satisfiability == 1 ? QDPLL_QTYPE_EXISTS : QDPLL_QTYPE_FORALL;
+
+  mgr->outer = mgr->inner = qdpll_new_scope(mgr->qdpll, outer_scope_quantor);
+  for (p = mgr->first_prefix; p; p = p->next) {
+    lit = mgr->idxs[p->node] = ++mgr->idx;
+
+    if (scope != (int) p->type) {
+
+      if (scope)
+        qdpll_add(mgr->qdpll, 0);
+
+      mgr->inner = qdpll_new_scope(
+          mgr->qdpll, p->type == ALL ? QDPLL_QTYPE_FORALL : QDPLL_QTYPE_EXISTS);
+      scope = p->type;
+    }
+    qdpll_add(mgr->qdpll, lit);
+  }
+  if (scope)
+    qdpll_add(mgr->qdpll, 0);
+
+  if (scope == ALL) {
+    mgr->inner = qdpll_new_scope(mgr->qdpll, QDPLL_QTYPE_EXISTS);
+    qdpll_add(mgr->qdpll, 0);
+  }
+}
+
+/*------------------------------------------------------------------------*/
+
+static int parse_prefix(Mgr *mgr) {
+  Type token;
+  Ref v;
+  PNode *p, *n = NULL;
+
+  if (mgr->token == ERROR)
+    return 0;
+
+  while ((mgr->token == ALL) || (mgr->token == EX)) {
+    token = mgr->token;
+    next_token(mgr);
+    if (mgr->token != VAR)
+      return 0;
+    v = var(mgr, mgr->symbol);
+    p = (PNode *)malloc(sizeof(*p));
+    p->node = node_id(v);
+    p->type = token;
+    p->next = NULL;
+    if (n) {
+      n->next = p;
+    } else {
+      mgr->first_prefix = n = p;
+    }
+    n = p;
+
+    next_token(mgr);
+  }
+
+  declare_prefix(mgr);
+
+  return 1;
+}
+#endif
+
+/*------------------------------------------------------------------------*/
+/* The parser is an operator precedence parser with explicit stacks, so the
+ * nesting depth of formulas is not limited by the size of the C stack.  It
+ * accepts the grammar described in 'README', calls 'var' and 'op' in the
+ * same order as a recursive descent parser for that grammar would, and also
+ * reports the same parse errors.
+ *
+ * The operator stack contains open parentheses, negations and binary
+ * operators still waiting for their right operand.  Consecutive open
+ * parentheses share one frame, thus the stacks only grow with the number of
+ * pending operators.  Chains of conjunctions or disjunctions on the same
+ * level share one frame too and are turned into one n-ary node.  For
+ * if-then-else an ITE frame waits for the ':' and a COLON frame for the
+ * else-branch.  The frame of a cardinality constraint keeps its arguments
+ * on the argument stack until the closing parenthesis.
+ */
+typedef struct Frame Frame;
+typedef struct Parser Parser;
+
+struct Frame
+{
+  Type type;			/* LP, NOT, a binary operator or cardinality */
+  unsigned count;		/* open parentheses, AND / OR or the bound */
+  unsigned base;		/* first argument of a cardinality constraint */
+};
+
+struct Parser
+{
+  Frame *ops;
+  unsigned ops_size;
+  unsigned ops_count;
+  Ref *args;
+  unsigned args_size;
+  unsigned args_count;
+};
+
+/*------------------------------------------------------------------------*/
+
+static Type
+top_op (Parser * parser)
+{
+  return parser->ops_count ? parser->ops[parser->ops_count - 1].type : DONE;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+push_op (Parser * parser, Type type)
+{
+  Frame *top;
+
+  if ((type == LP || is_nary (type)) && top_op (parser) == type)
+    {
+      parser->ops[parser->ops_count - 1].count++;
+      return;
+    }
+
+  if (parser->ops_size == parser->ops_count)
+    {
+      parser->ops_size = parser->ops_size ? 2 * parser->ops_size : 16;
+      parser->ops = (Frame *) realloc (parser->ops,
+				       parser->ops_size * sizeof (Frame));
+    }
+
+  top = parser->ops + parser->ops_count++;
+  top->type = type;
+  top->count = 1;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+push_arg (Parser * parser, Ref node)
+{
+  if (parser->args_size == parser->args_count)
+    {
+      parser->args_size = parser->args_size ? 2 * parser->args_size : 16;
+      parser->args = (Ref *) realloc (parser->args,
+					parser->args_size * sizeof (Ref));
+    }
+
+  parser->args[parser->args_count++] = node;
+}
+
+/*------------------------------------------------------------------------*/
+/* Binding strength of binary operators.  Smaller values bind stronger.
+ */
+static int
+priority (Type type)
+{
+  return type == SEILPMI ? IMPLIES : type;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+is_binary (Type type)
+{
+  return type == AND || type == OR || type == IMPLIES || type == SEILPMI
+    || type == IFF;
+}
+
+/*------------------------------------------------------------------------*/
+/* Build the nodes of all pending binary operators which bind at least as
+ * strong as 'limit'.
+ */
+static void
+reduce (Mgr * mgr, Parser * parser, int limit)
+{
+  Ref l, r, *args;
+  unsigned size;
+  Type type;
+
+  while (is_binary (type = top_op (parser)) && priority (type) <= limit)
+    {
+      size = parser->ops[--parser->ops_count].count + 1;
+      assert (parser->args_count >= size);
+      if (is_nary (type))
+	{
+	  parser->args_count -= size - 1;
+	  args = parser->args + parser->args_count - 1;
+	  *args = nary (mgr, type, args, size);
+	}
+      else
+	{
+	  r = parser->args[--parser->args_count];
+	  l = parser->args[parser->args_count - 1];
+	  parser->args[parser->args_count - 1] = op (mgr, type, l, r);
+	}
+    }
+}
+
+/*------------------------------------------------------------------------*/
+
+/* Build the nodes of all if-then-else operators with complete else-branch.
+ */
+static void
+reduce_ites (Mgr * mgr, Parser * parser)
+{
+  Ref c, t, e;
+
+  while (top_op (parser) == COLON)
+    {
+      parser->ops_count--;
+      assert (parser->args_count >= 3);
+      e = parser->args[--parser->args_count];
+      t = parser->args[--parser->args_count];
+      c = parser->args[parser->args_count - 1];
+      parser->args[parser->args_count - 1] = ite (mgr, c, t, e);
+    }
+}
+
+/*------------------------------------------------------------------------*/
+/* The names of cardinality constraints are only keywords if they are
+ * followed by '(', which is not valid after a variable.  Thus they remain
+ * valid variable names.
+ */
+static Type
+keyword (Mgr * mgr, unsigned symbol)
+{
+  const char *name;
+
+  if (mgr->symbols[symbol].length != 6 && mgr->symbols[symbol].length != 7)
+    return VAR;
+
+  name = symbol_name (mgr, symbol);
+  if (!strcmp (name, "atmost"))
+    return ATMOST;
+  if (!strcmp (name, "atleast"))
+    return ATLEAST;
+  if (!strcmp (name, "exactly"))
+    return EXACTLY;
+
+  return VAR;
+}
+
+/*------------------------------------------------------------------------*/
+/* The bound of a cardinality constraint is a decimal number followed by
+ * ';', which the caller lexes with 'bound' set.
+ */
+static int
+parse_bound (Mgr * mgr, unsigned *bound)
+{
+  unsigned res;
+
+  if (mgr->token != NUMBER)
+    {
+      if (mgr->token != ERROR)
+	parse_error (mgr, "expected number");
+      return 0;
+    }
+
+  res = mgr->number;
+  next_token (mgr);
+  if (mgr->token != SEMI)
+    {
+      if (mgr->token != ERROR)
+	parse_error (mgr, "expected ';'");
+      return 0;
+    }
+
+  next_token (mgr);
+  *bound = res;
+
+  return 1;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+apply_nots (Mgr * mgr, Parser * parser)
+{
+  Ref *arg;
+
+  arg = parser->args + parser->args_count - 1;
+  while (top_op (parser) == NOT)
+    {
+      parser->ops_count--;
+      *arg = op (mgr, NOT, *arg, 0);
+    }
+}
+
+/*------------------------------------------------------------------------*/
+
+static Ref
+parse_expr (Mgr * mgr)
+{
+  unsigned symbol, size;
+  Parser parser;
+  Frame *frame;
+  Ref res;
+  Type type;
+
+  memset (&parser, 0, sizeof (parser));
+  res = 0;
+
+  for (;;)
+    {
+      /* Expect an operand, possibly preceded by negations and parentheses.
+       */
+      if (mgr->token == NOT || mgr->token == LP)
+	{
+	  push_op (&parser, mgr->token);
+	  next_token (mgr);
+	  continue;
+	}
+
+      if (mgr->token != VAR)
+	{
+	  if (mgr->token != ERROR)
+	    parse_error (mgr, "expected variable or '('");
+	  goto FAILED;
+	}
+
+      symbol = mgr->symbol;
+      type = keyword (mgr, symbol);
+      next_token (mgr);
+
+      if (type != VAR && mgr->token == LP)
+	{
+	  push_op (&parser, type);
+	  frame = parser.ops + parser.ops_count - 1;
+	  frame->base = parser.args_count;
+	  mgr->cardinalities++;
+	  mgr->bound = 1;
+	  next_token (mgr);
+	  mgr->bound = 0;
+	  if (!parse_bound (mgr, &frame->count))
+	    goto FAILED;
+	  continue;
+	}
+
+      push_arg (&parser, var (mgr, symbol));
+
+    OPERAND_COMPLETE:
+
+      apply_nots (mgr, &parser);
+
+      /* Expect a binary operator, a closing parenthesis or the end.
+       * Implications are not associative, thus a second implication on the
+       * same level ends the expression as any other unexpected token does.
+       */
+      type = mgr->token;
+      if (is_binary (type))
+	{
+	  if (priority (type) == IMPLIES)
+	    {
+	      reduce (mgr, &parser, OR);
+	      if (priority (top_op (&parser)) == IMPLIES)
+		goto EXPRESSION_COMPLETE;
+	    }
+	  else if (is_nary (type))
+	    reduce (mgr, &parser, priority (type) - 1);
+	  else
+	    reduce (mgr, &parser, priority (type));
+
+	  push_op (&parser, type);
+	  next_token (mgr);
+	  continue;
+	}
+
+      /* The condition of if-then-else is the whole expression on the
+       * current level.
+       */
+      if (type == EX)
+	{
+	  reduce (mgr, &parser, IFF);
+	  push_op (&parser, ITE);
+	  next_token (mgr);
+	  continue;
+	}
+
+    EXPRESSION_COMPLETE:
+
+      reduce (mgr, &parser, IFF);
+      reduce_ites (mgr, &parser);
+
+      if (top_op (&parser) == ITE)
+	{
+	  if (mgr->token == COLON)
+	    {
+	      parser.ops[parser.ops_count - 1].type = COLON;
+	      next_token (mgr);
+	      continue;
+	    }
+
+	  if (mgr->token != ERROR)
+	    parse_error (mgr, "expected ':'");
+	  goto FAILED;
+	}
+
+      if (is_cardinality (type = top_op (&parser)))
+	{
+	  if (mgr->token == COMMA)
+	    {
+	      next_token (mgr);
+	      continue;
+	    }
+
+	  frame = parser.ops + --parser.ops_count;
+	  mgr->cardinalities--;
+	  if (mgr->token == RP)
+	    {
+	      size = parser.args_count - frame->base;
+	      parser.args_count = frame->base;
+	      push_arg (&parser, cardinality (mgr, type, frame->count,
+					      parser.args + frame->base,
+					      size));
+	      next_token (mgr);
+	      goto OPERAND_COMPLETE;
+	    }
+
+	  if (mgr->token != ERROR)
+	    parse_error (mgr, "expected ',' or ')'");
+	  next_token (mgr);
+	  goto FAILED;
+	}
+
+      if (top_op (&parser) != LP)
+	{
+	  assert (!parser.ops_count);
+	  assert (parser.args_count == 1);
+	  res = parser.args[0];
+	  break;
+	}
+
+      frame = parser.ops + parser.ops_count - 1;
+      if (!--frame->count)
+	parser.ops_count--;
+
+      if (mgr->token == RP)
+	{
+	  next_token (mgr);
+	  goto OPERAND_COMPLETE;
+	}
+
+      if (mgr->token != ERROR)
+	parse_error (mgr, "expected ')'");
+      next_token (mgr);
+
+    FAILED:
+
+      /* Every still open parenthesis expects a closing one, even though
+       * its argument is broken.  This may report additional errors.
+       */
+      while (parser.ops_count)
+	{
+	  frame = parser.ops + --parser.ops_count;
+	  if (is_cardinality (frame->type))
+	    frame->count = 1;
+	  else if (frame->type != LP)
+	    continue;
+
+	  while (frame->count--)
+	    {
+	      if (mgr->token != RP && mgr->token != ERROR)
+		parse_error (mgr, "expected ')'");
+	      next_token (mgr);
+	    }
+	}
+
+      mgr->cardinalities = 0;
+      break;
+    }
+
+  free (parser.ops);
+  free (parser.args);
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+parse (Mgr * mgr)
+{
+  if (mgr->token == ERROR)
+    return 0;
+
+  if (!(mgr->root = parse_expr (mgr)))
+    return 0;
+
+  if (mgr->token == DONE)
+    return 1;
+
+  if (mgr->token != ERROR)
+    parse_error (mgr, "expected operator or EOF");
+
+  return 0;
+}
+
+/*------------------------------------------------------------------------*/
+/* Large inputs are often one huge top-level conjunction.  With '-j' its
+ * conjuncts are split into consecutive groups, one for each thread, which
+ * are parsed in parallel by local managers with their own symbol and
+ * unique tables.  The local nodes are then merged into the global manager
+ * group by group in the order of their local node IDs, which gives the
+ * same node IDs as parsing sequentially.  If the input is not a top-level
+ * conjunction or a group has an error, the input is parsed sequentially,
+ * which also reports the errors.
+ */
+#ifdef LIMBOOLE_USE_THREADS
+
+typedef struct Span Span;
+typedef struct Worker Worker;
+
+struct Span
+{
+  size_t begin;
+  size_t end;
+};
+
+/*------------------------------------------------------------------------*/
+/* Find the top-level conjuncts in the input, possibly nested in enclosing
+ * parentheses.  Returns the number of conjuncts, or zero if the input is
+ * not a conjunction of at least two conjuncts.  Operators binding weaker
+ * than '&' outside of parentheses make the input a single conjunct, while
+ * anything else which does not parse is left to the sequential parser.
+ */
+static unsigned
+split_conjunction (Mgr * mgr, Span ** spans_ptr)
+{
+  size_t begin, end, first, last, first_close, pos;
+  unsigned count, size, depth;
+  Span *spans;
+  int ch;
+
+  begin = 0;
+  end = mgr->input_length;
+  spans = 0;
+  size = 0;
+
+  for (;;)
+    {
+      count = depth = 0;
+      first = last = first_close = end;
+
+      for (pos = begin; pos < end; pos++)
+	{
+	  ch = mgr->input[pos];
+
+	  if (ch == '%')
+	    {
+	      while (pos + 1 < end && mgr->input[pos + 1] != '\n')
+		pos++;
+	      continue;
+	    }
+
+	  if (ch == ' ' || (ch >= '\t' && ch <= '\r'))
+	    continue;
+
+	  if (first == end)
+	    first = pos;
+	  last = pos;
+
+	  if (ch == '(')
+	    depth++;
+	  else if (ch == ')')
+	    {
+	      if (!depth)
+		goto FAILED;
+	      if (!--depth && first_close == end)
+		first_close = pos;
+	    }
+	  else if (depth)
+	    continue;
+	  else if (ch == '&')
+	    {
+	      if (size == count)
+		{
+		  size = size ? 2 * size : 16;
+		  spans = (Span *) realloc (spans, size * sizeof (Span));
+		}
+	      spans[count].begin = count ? spans[count - 1].end + 1 : begin;
+	      spans[count++].end = pos;
+	    }
+	  else if (ch == '|' || ch == '/' || ch == '<' || ch == '?'
+		   || ch == '#' || (ch == '-' && pos + 1 < end
+				    && mgr->input[pos + 1] == '>'))
+	    goto FAILED;
+	}
+
+      if (depth)
+	goto FAILED;
+
+      if (count)
+	break;
+
+      /* No conjunction on this level, but it might be enclosed in
+       * parentheses.
+       */
+      if (first == end || mgr->input[first] != '(' || first_close != last)
+	goto FAILED;
+
+      begin = first + 1;
+      end = last;
+    }
+
+  if (size == count)
+    spans = (Span *) realloc (spans, (size + 1) * sizeof (Span));
+  spans[count].begin = spans[count - 1].end + 1;
+  spans[count++].end = end;
+
+  *spans_ptr = spans;
+
+  return count;
+
+FAILED:
+  free (spans);
+
+  return 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+struct Worker
+{
+  Mgr *mgr;			/* local manager, logging disabled */
+  const char *input;
+  Span *spans;
+  unsigned num_spans;
+  Ref *roots;			/* local roots of the conjuncts */
+  int ok;
+  int joinable;			/* 'thread' has been started */
+  pthread_t thread;
+};
+
+/*------------------------------------------------------------------------*/
+
+static void *
+parse_conjuncts (void *arg)
+{
+  Worker *worker;
+  unsigned i;
+  Mgr *mgr;
+
+  worker = (Worker *) arg;
+  mgr = worker->mgr;
+  worker->ok = 1;
+
+  for (i = 0; worker->ok && i < worker->num_spans; i++)
+    {
+      mgr->input = (char *) worker->input + worker->spans[i].begin;
+      mgr->input_length = worker->spans[i].end - worker->spans[i].begin;
+      mgr->input_pos = 0;
+      next_token (mgr);
+
+      if (parse (mgr))
+	worker->roots[i] = mgr->root;
+      else
+	worker->ok = 0;
+    }
+
+  return 0;
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Rebuild the local nodes of a worker in the global manager.  Children have
+ * smaller node IDs than their parents and are thus mapped first.
+ */
+static void
+merge_conjuncts (Mgr * mgr, Worker * worker, Ref * roots)
+{
+  unsigned id, i, size;
+  Ref *map, *refs;
+  Symbol *s;
+  Mgr *local;
+  Type type;
+
+  local = worker->mgr;
+  map = (Ref *) malloc ((local->nodes_count + 1) * sizeof (Ref));
+  refs = 0;
+  size = 0;
+
+  for (id = 1; id <= local->nodes_count; id++)
+    {
+      type = (Type) local->types[id];
+      if (type == VAR)
+	{
+	  s = local->symbols + local->child0[id];
+	  map[id] = var (mgr, intern (mgr, local->pool + s->name,
+				      s->length, s->hash));
+	}
+      else if (is_nary (type) || is_cardinality (type))
+	{
+	  if (size < local->child1[id])
+	    {
+	      size = local->child1[id];
+	      refs = (Ref *) realloc (refs, size * sizeof (Ref));
+	    }
+
+	  for (i = 0; i < local->child1[id]; i++)
+	    refs[i] = map_ref (map, local->refs[local->child0[id] + i]);
+
+	  if (is_nary (type))
+	    map[id] = nary (mgr, type, refs, local->child1[id]);
+	  else
+	    map[id] = cardinality (mgr, type, bound_of (local, id << 1),
+				   refs, local->child1[id]);
+	}
+      else if (type == ITE)
+	map[id] = ite (mgr,
+		       map_ref (map, local->refs[local->child0[id]]),
+		       map_ref (map, local->refs[local->child0[id] + 1]),
+		       map_ref (map, local->refs[local->child0[id] + 2]));
+      else
+	map[id] = op (mgr, type,
+		      map_ref (map, local->child0[id]),
+		      map_ref (map, local->child1[id]));
+    }
+
+  for (i = 0; i < worker->num_spans; i++)
+    roots[i] = map_ref (map, worker->roots[i]);
+
+  free (refs);
+  free (map);
+}
+
+/*------------------------------------------------------------------------*/
+/* Returns non-zero if the input has been parsed in parallel.
+ */
+static int
+parse_parallel (Mgr * mgr)
+{
+  unsigned num_spans, num_workers, i, t;
+  Worker *workers, *w;
+  Span *spans;
+  size_t limit;
+  Ref *roots;
+  int ok;
+
+  if (mgr->threads < 2 || mgr->use_depqbf)
+    return 0;
+
+  if (!(num_spans = split_conjunction (mgr, &spans)))
+    return 0;
+
+  num_workers = (unsigned) mgr->threads;
+  if (num_workers > num_spans)
+    num_workers = num_spans;
+
+  workers = (Worker *) calloc (num_workers, sizeof (Worker));
+  roots = (Ref *) malloc (num_spans * sizeof (Ref));
+
+  for (i = t = 0; t < num_workers; t++)
+    {
+      w = workers + t;
+      w->input = mgr->input;
+      w->spans = spans + i;
+
+      limit = spans[0].begin +
+	(spans[num_spans - 1].end - spans[0].begin) / num_workers * (t + 1);
+      do
+	i++;
+      while (num_spans - i > num_workers - t - 1
+	     && (t + 1 == num_workers || spans[i].begin < limit));
+
+      w->num_spans = (unsigned) (spans + i - w->spans);
+      w->roots = roots + (w->spans - spans);
+      w->mgr = init ();
+      w->mgr->log = 0;
+      reserve_nodes (w->mgr, (w->spans[w->num_spans - 1].end -
+			      w->spans[0].begin) / 16);
+
+      if (!pthread_create (&w->thread, 0, parse_conjuncts, w))
+	w->joinable = 1;
+      else
+	parse_conjuncts (w);
+    }
+
+  ok = 1;
+  for (t = 0; t < num_workers; t++)
+    {
+      w = workers + t;
+      if (w->joinable)
+	pthread_join (w->thread, 0);
+      ok &= w->ok;
+    }
+
+  if (ok)
+    {
+      for (t = 0; t < num_workers; t++)
+	merge_conjuncts (mgr, workers + t, roots + (workers[t].spans - spans));
+
+      mgr->root = nary (mgr, AND, roots, num_spans);
+
+      if (mgr->verbose)
+	fprintf (mgr->log, "c parsed %u conjuncts with %u threads\n",
+		 num_spans, num_workers);
+    }
+
+  for (t = 0; t < num_workers; t++)
+    release (workers[t].mgr);
+
+  free (workers);
+  free (roots);
+  free (spans);
+
+  return ok;
+}
+
+#else
+
+static int
+parse_parallel (Mgr * mgr)
+{
+  (void) mgr;
+  return 0;
+}
+
+#endif
+
+/*------------------------------------------------------------------------*/
+/* Compiled formulas ('-c') are binary images of the symbols, the nodes and
+ * the quantifier prefix.  Loading them just copies and checks arrays, thus
+ * there is neither lexing nor hashing.  The header is followed by the
+ * sections listed in 'DagHeader' in that order, each padded to a multiple
+ * of eight bytes.  Numbers are stored in the byte order of the writer.
+ */
+#define DAG_MAGIC "\177LIMBOOLE-DAG\n"
+#define DAG_VERSION 1
+#define DAG_BYTE_ORDER 0x01020304u
+
+typedef struct DagHeader DagHeader;
+
+struct DagHeader
+{
+  char magic[16];
+  unsigned version;
+  unsigned byte_order;
+  unsigned num_symbols;		/* hash and length of each symbol */
+  unsigned num_nodes;		/* types, then 'child0' and 'child1' */
+  unsigned num_prefix;		/* quantifier and node of each variable */
+  Ref root;
+  unsigned long long pool_size;	/* zero terminated names */
+  unsigned long long num_refs;	/* children of AND, OR and ITE */
+};
+
+/*------------------------------------------------------------------------*/
+
+static size_t
+padded (size_t bytes)
+{
+  return (bytes + 7) & ~(size_t) 7;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+write_section (FILE * file, const void *data, size_t bytes)
+{
+  static const char zeros[8];
+
+  if (bytes)
+    fwrite (data, 1, bytes, file);
+  fwrite (zeros, 1, padded (bytes) - bytes, file);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+write_dag (Mgr * mgr, FILE * file)
+{
+  unsigned *pairs, num_prefix, i;
+  DagHeader header;
+  PNode *p;
+
+  num_prefix = 0;
+  for (p = mgr->first_prefix; p; p = p->next)
+    num_prefix++;
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, DAG_MAGIC, sizeof (DAG_MAGIC));
+  header.version = DAG_VERSION;
+  header.byte_order = DAG_BYTE_ORDER;
+  header.num_symbols = mgr->symbols_count;
+  header.num_nodes = mgr->nodes_count;
+  header.num_prefix = num_prefix;
+  header.root = mgr->root;
+  header.pool_size = mgr->pool_count;
+  header.num_refs = mgr->refs_count;
+
+  write_section (file, &header, sizeof (header));
+  write_section (file, mgr->pool, mgr->pool_count);
+
+  pairs = (unsigned *) malloc (2 * sizeof (unsigned) *
+			       (mgr->symbols_count + num_prefix + 1));
+  for (i = 0; i < mgr->symbols_count; i++)
+    {
+      pairs[2 * i] = mgr->symbols[i].hash;
+      pairs[2 * i + 1] = mgr->symbols[i].length;
+    }
+  write_section (file, pairs, 2 * sizeof (unsigned) * mgr->symbols_count);
+
+  write_section (file, mgr->types + 1, mgr->nodes_count);
+  write_section (file, mgr->child0 + 1, mgr->nodes_count * sizeof (unsigned));
+  write_section (file, mgr->child1 + 1, mgr->nodes_count * sizeof (unsigned));
+  write_section (file, mgr->refs, mgr->refs_count * sizeof (Ref));
+
+  for (i = 0, p = mgr->first_prefix; p; p = p->next, i++)
+    {
+      pairs[2 * i] = p->type;
+      pairs[2 * i + 1] = p->node;
+    }
+  write_section (file, pairs, 2 * sizeof (unsigned) * num_prefix);
+  free (pairs);
+
+  return !fflush (file) && !ferror (file);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+is_dag (Mgr * mgr)
+{
+  return mgr->input_length >= sizeof (DagHeader)
+    && !memcmp (mgr->input, DAG_MAGIC, sizeof (DAG_MAGIC));
+}
+
+/*------------------------------------------------------------------------*/
+/* Returns the next section of the input or zero if the input is too short.
+ */
+static const char *
+next_section (Mgr * mgr, unsigned long long bytes)
+{
+  const char *res;
+
+  if (bytes > mgr->input_length - mgr->input_pos)
+    return 0;
+
+  res = mgr->input + mgr->input_pos;
+  if (padded (bytes) > mgr->input_length - mgr->input_pos)
+    mgr->input_pos = mgr->input_length;
+  else
+    mgr->input_pos += padded (bytes);
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+valid_child (Ref ref, unsigned parent)
+{
+  return node_id (ref) && node_id (ref) < parent;
+}
+
+/*------------------------------------------------------------------------*/
+/* Load a compiled formula and check that it is well formed, in particular
+ * that children precede their parents.  The symbol and unique tables stay
+ * empty, since no nodes are added after loading.
+ */
+static int
+load_dag (Mgr * mgr)
+{
+  const char *pool, *symbols, *types, *child0, *child1, *refs, *prefix;
+  unsigned i, id, c0, c1, pair[2];
+  DagHeader header;
+  PNode *p, *last;
+  size_t offset;
+  Symbol *s;
+
+  memcpy (&header, mgr->input, sizeof (header));
+  mgr->input_pos = sizeof (header);
+
+  if (header.version != DAG_VERSION || header.byte_order != DAG_BYTE_ORDER)
+    return 0;
+
+  if (!(pool = next_section (mgr, header.pool_size))
+      || !(symbols = next_section (mgr, 8ull * header.num_symbols))
+      || !(types = next_section (mgr, header.num_nodes))
+      || !(child0 = next_section (mgr, 4ull * header.num_nodes))
+      || !(child1 = next_section (mgr, 4ull * header.num_nodes))
+      || !(refs = next_section (mgr, 4ull * header.num_refs))
+      || !(prefix = next_section (mgr, 8ull * header.num_prefix)))
+    return 0;
+
+  mgr->pool_size = mgr->pool_count = header.pool_size;
+  mgr->pool = (char *) malloc (mgr->pool_size + 1);
+  memcpy (mgr->pool, pool, mgr->pool_size);
+
+  mgr->symbols_size = mgr->symbols_count = header.num_symbols;
+  mgr->symbols = (Symbol *) malloc ((mgr->symbols_size + 1) * sizeof (Symbol));
+  for (i = 0, offset = 0; i < header.num_symbols; i++)
+    {
+      memcpy (pair, symbols + 8 * (size_t) i, sizeof (pair));
+      if (pair[1] >= mgr->pool_size - offset || mgr->pool[offset + pair[1]])
+	return 0;
+
+      s = mgr->symbols + i;
+      s->hash = pair[0];
+      s->length = pair[1];
+      s->name = offset;
+      s->node = 0;
+      offset += pair[1] + 1;
+    }
+
+  if (header.num_nodes >= mgr->nodes_size)
+    resize_nodes (mgr, header.num_nodes + 1);
+
+  memcpy (mgr->types + 1, types, header.num_nodes);
+  memcpy (mgr->child0 + 1, child0, header.num_nodes * sizeof (unsigned));
+  memcpy (mgr->child1 + 1, child1, header.num_nodes * sizeof (unsigned));
+  memset (mgr->marks, 0, header.num_nodes + 1);
+  memset (mgr->idxs, 0, (header.num_nodes + 1) * sizeof (int));
+
+  mgr->refs_size = mgr->refs_count = header.num_refs;
+  mgr->refs = (Ref *) malloc ((mgr->refs_size + 1) * sizeof (Ref));
+  memcpy (mgr->refs, refs, mgr->refs_size * sizeof (Ref));
+
+  for (id = 1; id <= header.num_nodes; id++)
+    {
+      c0 = mgr->child0[id];
+      c1 = mgr->child1[id];
+      switch (mgr->types[id])
+	{
+	case VAR:
+	  if (c0 >= mgr->symbols_count || mgr->symbols[c0].node)
+	    return 0;
+	  mgr->symbols[c0].node = id;
+	  break;
+	case AND:
+	case OR:
+	  if (c1 < 2 || c0 > mgr->refs_count || c1 > mgr->refs_count - c0)
+	    return 0;
+	  for (i = c0; i < c0 + c1; i++)
+	    if (!valid_child (mgr->refs[i], id))
+	      return 0;
+	  break;
+	case ITE:
+	  if (c1 != 3 || c0 > mgr->refs_count || c1 > mgr->refs_count - c0)
+	    return 0;
+	  for (i = c0; i < c0 + c1; i++)
+	    if (!valid_child (mgr->refs[i], id))
+	      return 0;
+	  break;
+	case ATMOST:
+	case ATLEAST:
+	case EXACTLY:
+	  if (!c1 || c0 > mgr->refs_count || c1 >= mgr->refs_count - c0)
+	    return 0;
+	  for (i = c0; i < c0 + c1; i++)
+	    if (!valid_child (mgr->refs[i], id))
+	      return 0;
+	  break;
+	case IMPLIES:
+	case SEILPMI:
+	case IFF:
+	  if (!valid_child (c0, id) || !valid_child (c1, id))
+	    return 0;
+	  break;
+	default:
+	  return 0;
+	}
+    }
+
+  mgr->nodes_count = header.num_nodes;
+  if (!valid_child (header.root, header.num_nodes + 1))
+    return 0;
+  mgr->root = header.root;
+
+  last = 0;
+  for (i = 0; i < header.num_prefix; i++)
+    {
+      memcpy (pair, prefix + 8 * (size_t) i, sizeof (pair));
+      if ((pair[0] != ALL && pair[0] != EX) || !pair[1]
+	  || pair[1] > mgr->nodes_count || mgr->types[pair[1]] != VAR)
+	return 0;
+
+      p = (PNode *) malloc (sizeof (*p));
+      p->type = (Type) pair[0];
+      p->node = pair[1];
+      p->next = 0;
+      if (last)
+	last->next = p;
+      else
+	mgr->first_prefix = p;
+      last = p;
+    }
+
+  return 1;
+}
+
+/*------------------------------------------------------------------------*/
+
+static Ref
+or2 (Mgr * mgr, Ref a, Ref b)
+{
+  return negate (op (mgr, AND, negate (a), negate (b)));
+}
+
+/*------------------------------------------------------------------------*/
+/* Sequential counter: after the first 'i' children 'sums[j]' is true iff at
+ * least 'j + 1' of them are true.  Returns whether at least 'm' children
+ * are true with about '2 * size * m' gates.
+ */
+static Ref
+sequential_counter (Mgr * mgr, Ref * refs, unsigned size, unsigned m)
+{
+  Ref *sums, carry, res;
+  unsigned i, j;
+
+  assert (0 < m && m <= size);
+
+  sums = (Ref *) malloc (m * sizeof (Ref));
+  for (i = 0; i < size; i++)
+    for (j = (i < m ? i : m - 1) + 1; j--;)
+      {
+	carry = j ? op (mgr, AND, sums[j - 1], refs[i]) : refs[i];
+	sums[j] = j == i ? carry : or2 (mgr, sums[j], carry);
+      }
+
+  res = sums[m - 1];
+  free (sums);
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+/* Batcher's odd-even merge sort of the children in decreasing order, where
+ * a comparator is one conjunction and one disjunction.  The children are
+ * padded with FALSE to a power of two.  Comparators with padding do not
+ * change anything and are omitted.  Returns whether at least 'm' children
+ * are true with about 'size * log (size)^2 / 2' gates independent of 'm'.
+ */
+static Ref
+sorting_network (Mgr * mgr, Ref * refs, unsigned size, unsigned m)
+{
+  unsigned n, p, k, i, j, a, b;
+  Ref *wires, max, res;
+
+  assert (0 < m && m <= size);
+
+  wires = (Ref *) malloc (size * sizeof (Ref));
+  memcpy (wires, refs, size * sizeof (Ref));
+
+  for (n = 1; n < size; n *= 2)
+    ;
+
+  for (p = 1; p < n; p *= 2)
+    for (k = p; k; k /= 2)
+      for (j = k % p; j + k < size; j += 2 * k)
+	for (i = 0; i < k && i + j + k < size; i++)
+	  {
+	    a = i + j;
+	    b = i + j + k;
+	    if (a / (2 * p) != b / (2 * p))
+	      continue;
+	    max = or2 (mgr, wires[a], wires[b]);
+	    wires[b] = op (mgr, AND, wires[a], wires[b]);
+	    wires[a] = max;
+	  }
+
+  res = wires[m - 1];
+  free (wires);
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+/* At most 'k' children are true iff not at least 'k + 1' are.  For large
+ * bounds the false children are counted instead.  Sequential counters are
+ * smaller for small bounds, sorting networks otherwise.  The children in
+ * 'refs' are overwritten.
+ */
+static Ref
+atmost (Mgr * mgr, Ref * refs, unsigned size, unsigned k)
+{
+  unsigned i, m, log;
+
+  if (k >= size)
+    return negate (constant (mgr));
+
+  if (size <= 2 * k)
+    {
+      for (i = 0; i < size; i++)
+	refs[i] = negate (refs[i]);
+      return negate (atmost (mgr, refs, size, size - k - 1));
+    }
+
+  if (!k)
+    {
+      for (i = 0; i < size; i++)
+	refs[i] = negate (refs[i]);
+      return nary (mgr, AND, refs, size);
+    }
+
+  m = k + 1;
+  for (log = 0; (1u << log) < size; log++)
+    ;
+
+  if (4 * m <= log * log)
+    return negate (sequential_counter (mgr, refs, size, m));
+
+  return negate (sorting_network (mgr, refs, size, m));
+}
+
+/*------------------------------------------------------------------------*/
+
+static Ref
+expand_cardinality (Mgr * mgr, Type type, unsigned k, Ref * refs,
+		    unsigned size)
+{
+  Ref *copy, a, b;
+
+  if (type == ATMOST)
+    return atmost (mgr, refs, size, k);
+
+  if (!k)
+    return type == ATLEAST ? negate (constant (mgr))
+      : atmost (mgr, refs, size, 0);
+
+  if (type == ATLEAST)
+    return negate (atmost (mgr, refs, size, k - 1));
+
+  assert (type == EXACTLY);
+
+  copy = (Ref *) malloc (size * sizeof (Ref));
+  memcpy (copy, refs, size * sizeof (Ref));
+  a = atmost (mgr, refs, size, k);
+  b = negate (atmost (mgr, copy, size, k - 1));
+  free (copy);
+
+  return op (mgr, AND, a, b);
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+has_cardinality (Mgr * mgr)
+{
+  unsigned id;
+
+  for (id = 1; id <= mgr->nodes_count; id++)
+    if (is_cardinality ((Type) mgr->types[id]))
+      return 1;
+
+  return 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+push_leaf (Mgr * mgr, Ref ref)
+{
+  if (mgr->leaves_size == mgr->leaves_count)
+    {
+      mgr->leaves_size = mgr->leaves_size ? 2 * mgr->leaves_size : 16;
+      mgr->leaves = (Ref *) realloc (mgr->leaves,
+				     mgr->leaves_size * sizeof (Ref));
+    }
+
+  mgr->leaves[mgr->leaves_count++] = ref;
+}
+
+/*------------------------------------------------------------------------*/
+/* An equivalence is the negated XOR of its children, thus a tree of
+ * equivalences is the XOR of its leaves, the nodes below it which are not
+ * equivalences, and a constant.  A leaf reached on an even number of paths
+ * cancels out, as does FALSE.  The remaining leaves of 'ref' are stored
+ * sorted in 'leaves' and the constant is returned.  Parents have larger IDs
+ * than their children, thus visiting the equivalences in decreasing order
+ * of IDs counts the paths modulo two.  The two mark bits not used by
+ * 'nary' flag visited nodes and nodes reached an odd number of times.
+ */
+#define XOR_VISITED 4
+#define XOR_ODD 8
+
+static int
+xor_leaves (Mgr * mgr, Ref ref)
+{
+  unsigned *iffs, iffs_size, iffs_count, i, j, id, c;
+  int res;
+
+  res = is_negated (ref);
+  mgr->leaves_count = 0;
+  id = node_id (ref);
+  if (mgr->types[id] != IFF)
+    {
+      if (id != mgr->constant)
+	push_leaf (mgr, id << 1);
+      return res;
+    }
+
+  iffs_size = 16;
+  iffs = (unsigned *) malloc (iffs_size * sizeof (unsigned));
+  iffs[0] = id;
+  iffs_count = 1;
+  mgr->marks[id] = XOR_VISITED | XOR_ODD;
+
+  for (i = 0; i < iffs_count; i++)
+    {
+      id = iffs[i];
+      for (j = 0; j < 2; j++)
+	{
+	  c = node_id (j ? mgr->child1[id] : mgr->child0[id]);
+	  if (mgr->marks[c] & XOR_VISITED)
+	    continue;
+	  mgr->marks[c] = XOR_VISITED;
+	  if (mgr->types[c] != IFF)
+	    push_leaf (mgr, c << 1);
+	  else
+	    {
+	      if (iffs_size == iffs_count)
+		{
+		  iffs_size *= 2;
+		  iffs = (unsigned *) realloc (iffs,
+					       iffs_size * sizeof (unsigned));
+		}
+	      iffs[iffs_count++] = c;
+	    }
+	}
+    }
+
+  qsort (iffs, iffs_count, sizeof (unsigned), cmp_refs);
+  for (i = iffs_count; i--;)
+    {
+      id = iffs[i];
+      if (mgr->marks[id] & XOR_ODD)
+	{
+	  res ^= 1 ^ is_negated (mgr->child0[id])
+	    ^ is_negated (mgr->child1[id]);
+	  mgr->marks[node_id (mgr->child0[id])] ^= XOR_ODD;
+	  mgr->marks[node_id (mgr->child1[id])] ^= XOR_ODD;
+	}
+      mgr->marks[id] = 0;
+    }
+  free (iffs);
+
+  for (i = j = 0; i < mgr->leaves_count; i++)
+    {
+      id = node_id (mgr->leaves[i]);
+      if ((mgr->marks[id] & XOR_ODD) && id != mgr->constant)
+	mgr->leaves[j++] = mgr->leaves[i];
+      mgr->marks[id] = 0;
+    }
+  mgr->leaves_count = j;
+  qsort (mgr->leaves, j, sizeof (Ref), cmp_refs);
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+/* Rebuilds a tree of equivalences as a chain over its sorted leaves, thus
+ * equivalent trees share one node, as '(a <-> b) <-> c' and 'b <-> (c <->
+ * a)' do, and leaves occurring twice cancel out, as in '(a <-> b) <-> a'.
+ */
+static Ref
+xor_chain (Mgr * mgr, Ref ref)
+{
+  unsigned i;
+  int parity;
+  Ref res;
+
+  parity = xor_leaves (mgr, ref);
+  if (!mgr->leaves_count)
+    return constant (mgr) ^ parity;
+
+  res = mgr->leaves[0];
+  for (i = 1; i < mgr->leaves_count; i++)
+    res = negate (op (mgr, IFF, res, mgr->leaves[i]));
+
+  return res ^ parity;
+}
+
+/*------------------------------------------------------------------------*/
+/* Before encoding, the parsed formula is rewritten into an and-inverter
+ * graph with equivalences.  Disjunctions and implications become negated
+ * conjunctions, and the rewrite rules of 'op' and 'nary' are enabled, which
+ * give conjunctions sorted children and equivalences a canonical form, fold
+ * constants and remove trivial gates.  Thus '!a | b', 'a -> b' and 'b <- a'
+ * share one node, and 'a & !a' or 'a <-> a' need no gate at all.  The parsed
+ * nodes are still needed for pretty printing and compiling, thus
+ * normalization only happens right before 'tseitin'.  The nodes are rebuilt
+ * in a fresh node store in the order of their old IDs.  Trees of
+ * equivalences are rebuilt by 'xor_chain' at their roots, the equivalences
+ * with a parent of another type.  Cardinality constraints are always
+ * replaced by counters.  Without 'simplify' nothing else changes, which is
+ * used for '-d'.
+ */
+static void
+normalize (Mgr * mgr, int simplify)
+{
+  unsigned *child0, *child1, count, id, i, size, children_size;
+  Ref *refs, *map, *children, a, b;
+  unsigned char *types, *roots;
+  int *idxs;
+  PNode *p;
+
+  types = mgr->types;
+  child0 = mgr->child0;
+  child1 = mgr->child1;
+  idxs = mgr->idxs;
+  refs = mgr->refs;
+  count = mgr->nodes_count;
+
+  roots = 0;
+  if (simplify)
+    {
+      roots = (unsigned char *) calloc (count + 1, 1);
+      roots[node_id (mgr->root)] = 1;
+      for (id = 1; id <= count; id++)
+	switch (types[id])
+	  {
+	  case AND:
+	  case OR:
+	  case ITE:
+	  case ATMOST:
+	  case ATLEAST:
+	  case EXACTLY:
+	    for (i = 0; i < child1[id]; i++)
+	      roots[node_id (refs[child0[id] + i])] = 1;
+	    break;
+	  case IMPLIES:
+	  case SEILPMI:
+	    roots[node_id (child0[id])] = 1;
+	    roots[node_id (child1[id])] = 1;
+	    break;
+	  default:
+	    break;
+	  }
+    }
+
+  free (mgr->marks);
+  mgr->types = mgr->marks = 0;
+  mgr->child0 = mgr->child1 = 0;
+  mgr->idxs = 0;
+  mgr->nodes_size = mgr->nodes_count = 0;
+  mgr->refs = 0;
+  mgr->refs_size = mgr->refs_count = 0;
+  memset (mgr->table, 0, mgr->table_size * sizeof (Slot));
+  mgr->table_count = 0;
+  mgr->simplify = simplify;
+  mgr->constant = 0;
+
+  resize_nodes (mgr, count + 1);
+  mgr->types[0] = DONE;
+
+  for (i = 0; i < mgr->symbols_count; i++)
+    mgr->symbols[i].node = 0;
+
+  map = (Ref *) malloc ((count + 1) * sizeof (Ref));
+  children = 0;
+  children_size = 0;
+
+  for (id = 1; id <= count; id++)
+    {
+      switch (types[id])
+	{
+	case VAR:
+	  map[id] = var (mgr, child0[id]);
+	  mgr->idxs[node_id (map[id])] = idxs[id];	/* prefix */
+	  break;
+	case AND:
+	case OR:
+	case ATMOST:
+	case ATLEAST:
+	case EXACTLY:
+	  size = child1[id];
+	  if (children_size < size)
+	    {
+	      children_size = size;
+	      children = (Ref *) realloc (children, size * sizeof (Ref));
+	    }
+	  for (i = 0; i < size; i++)
+	    children[i] = map_ref (map, refs[child0[id] + i]);
+	  if (is_cardinality (types[id]))
+	    map[id] = expand_cardinality (mgr, types[id],
+					  refs[child0[id] + size],
+					  children, size);
+	  else
+	    map[id] = nary (mgr, types[id], children, size);
+	  break;
+	case IMPLIES:
+	case SEILPMI:
+	  a = map_ref (map, child0[id]);
+	  b = map_ref (map, child1[id]);
+	  map[id] = op (mgr, types[id], a, b);
+	  break;
+	case ITE:
+	  map[id] = ite (mgr, map_ref (map, refs[child0[id]]),
+			 map_ref (map, refs[child0[id] + 1]),
+			 map_ref (map, refs[child0[id] + 2]));
+	  break;
+	default:
+	  assert (types[id] == IFF);
+	  a = map_ref (map, child0[id]);
+	  b = map_ref (map, child1[id]);
+	  map[id] = op (mgr, IFF, a, b);
+	  if (simplify && roots[id] && mgr->types[node_id (map[id])] == IFF)
+	    map[id] = xor_chain (mgr, map[id]);
+	  break;
+	}
+    }
+
+  for (p = mgr->first_prefix; p; p = p->next)
+    p->node = node_id (map[p->node]);
+  mgr->root = map_ref (map, mgr->root);
+
+  if (mgr->verbose)
+    fprintf (mgr->log, "c normalized %u parsed nodes to %u nodes\n",
+	     count, mgr->nodes_count);
+
+  free (children);
+  free (roots);
+  free (map);
+  free (types);
+  free (child0);
+  free (child1);
+  free (idxs);
+  free (refs);
+}
+
+/*------------------------------------------------------------------------*/
+
+#define BATCH_SIZE (1 << 16)
+
+#ifdef LIMBOOLE_USE_PICOSAT
+static void
+picosat_add_clauses (Mgr * mgr, const int *lits, size_t count)
+{
+  const int *p, *end;
+
+  end = lits + count;
+  for (p = lits; p < end; p++)
+    {
+      picosat_add_lits (mgr->picosat, (int *) p);
+      while (*p)
+	p++;
+    }
+}
+
+static const Backend picosat_backend = { "PicoSAT", picosat_add_clauses };
+#endif
+
+#ifdef LIMBOOLE_USE_LINGELING
+static void
+lingeling_add_clauses (Mgr * mgr, const int *lits, size_t count)
+{
+  const int *p, *end;
+
+  end = lits + count;
+  for (p = lits; p < end; p++)
+    lgladd (mgr->lgl, *p);
+}
+
+static const Backend lingeling_backend = {
+  "Lingeling", lingeling_add_clauses
+};
+#endif
+
+#ifdef LIMBOOLE_USE_DEPQBF
+static void
+depqbf_add_clauses (Mgr * mgr, const int *lits, size_t count)
+{
+  const int *p, *end;
+
+  end = lits + count;
+  for (p = lits; p < end; p++)
+    qdpll_add (mgr->qdpll, *p);
+}
+
+static const Backend depqbf_backend = { "DepQBF", depqbf_add_clauses };
+#endif
+
+/*------------------------------------------------------------------------*/
+/* Dumping with '-d' formats numbers by hand into a large buffer, which is
+ * written straight to the file descriptor of the output file if possible.
+ * This avoids 'fprintf' and the locked stdio buffer for every literal.
+ */
+#define DUMP_SIZE (1 << 20)
+
+static void
+flush_dump (Mgr * mgr)
+{
+  const char *p;
+  size_t bytes;
+#ifdef LIMBOOLE_USE_WRITE
+  ssize_t written;
+#endif
+
+  p = mgr->dump_buffer;
+  bytes = mgr->dump_count;
+  mgr->dump_count = 0;
+#ifdef LIMBOOLE_USE_WRITE
+  fflush (mgr->out);
+  while (bytes)
+    {
+      written = write (fileno (mgr->out), p, bytes);
+      if (written < 0 && errno == EINTR)
+	continue;
+      if (written <= 0)
+	break;			/* e.g. memory streams without descriptor */
+      p += written;
+      bytes -= (size_t) written;
+    }
+#endif
+  if (bytes)
+    fwrite (p, 1, bytes, mgr->out);
+}
+
+/*------------------------------------------------------------------------*/
+/* Returns space for 'bytes' more bytes of output, at most 'DUMP_SIZE'.
+ */
+static char *
+dump_space (Mgr * mgr, size_t bytes)
+{
+  assert (bytes <= DUMP_SIZE);
+
+  if (!mgr->dump_buffer)
+    mgr->dump_buffer = (char *) malloc (DUMP_SIZE);
+  else if (DUMP_SIZE - mgr->dump_count < bytes)
+    flush_dump (mgr);
+
+  return mgr->dump_buffer + mgr->dump_count;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+dump_string (Mgr * mgr, const char *str)
+{
+  size_t len, bytes;
+
+  for (len = strlen (str); len; len -= bytes, str += bytes)
+    {
+      bytes = len < DUMP_SIZE ? len : DUMP_SIZE;
+      memcpy (dump_space (mgr, bytes), str, bytes);
+      mgr->dump_count += bytes;
+    }
+}
+
+/*------------------------------------------------------------------------*/
+/* Dump 'n' in decimal followed by the character 'sep'.
+ */
+static void
+dump_int (Mgr * mgr, int n, char sep)
+{
+  char tmp[12], *p, *q;
+  unsigned u;
+  size_t len;
+
+  p = tmp + sizeof (tmp);
+  *--p = sep;
+  u = n < 0 ? -(unsigned) n : (unsigned) n;
+  do
+    *--p = '0' + u % 10;
+  while (u /= 10);
+  if (n < 0)
+    *--p = '-';
+
+  len = tmp + sizeof (tmp) - p;
+  q = dump_space (mgr, len);
+  memcpy (q, p, len);
+  mgr->dump_count += len;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+dimacs_add_clauses (Mgr * mgr, const int *lits, size_t count)
+{
+  const int *p, *end;
+
+  end = lits + count;
+  for (p = lits; p < end; p++)
+    dump_int (mgr, *p, *p ? ' ' : '\n');
+}
+
+static const Backend dimacs_backend = { "DIMACS", dimacs_add_clauses };
+
+/*------------------------------------------------------------------------*/
+/* Keeps the whole encoding in 'mgr->cnf' to feed several solvers.
+ */
+static void
+cnf_add_clauses (Mgr * mgr, const int *lits, size_t count)
+{
+  Clauses *cnf;
+
+  cnf = &mgr->cnf;
+  while (cnf->size - cnf->count < count)
+    {
+      cnf->size = cnf->size ? 2 * cnf->size : BATCH_SIZE;
+      cnf->lits = (int *) realloc (cnf->lits, cnf->size * sizeof (int));
+    }
+
+  memcpy (cnf->lits + cnf->count, lits, count * sizeof (int));
+  cnf->count += count;
+}
+
+static const Backend cnf_backend = { "several solvers", cnf_add_clauses };
+
+/*------------------------------------------------------------------------*/
+
+static void
+select_backend (Mgr * mgr)
+{
+  mgr->backend = 0;
+
+  if (mgr->dump)
+    {
+      mgr->backend = &dimacs_backend;
+      return;
+    }
+  if (mgr->race || mgr->portfolio > 1)
+    {
+      mgr->backend = &cnf_backend;
+      return;
+    }
+#ifdef LIMBOOLE_USE_PICOSAT
+  if (mgr->picosat)
+    mgr->backend = &picosat_backend;
+#endif
+#ifdef LIMBOOLE_USE_LINGELING
+  if (mgr->lgl)
+    mgr->backend = &lingeling_backend;
+#endif
+#ifdef LIMBOOLE_USE_DEPQBF
+  if (mgr->qdpll)
+    mgr->backend = &depqbf_backend;
+#endif
+  assert (mgr->backend);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+add_clauses (Mgr * mgr, Clauses * clauses)
+{
+  if (clauses->count)
+    mgr->backend->add_clauses (mgr, clauses->lits, clauses->count);
+  mgr->num_clauses += clauses->num;
+  clauses->count = 0;
+  clauses->num = 0;
+}
+
+/*------------------------------------------------------------------------*/
+/* PicoSAT has no interrupt hook.  A running PicoSAT is cancelled from
+ * another thread by setting the flag 'mgr->cancel' and then setting its
+ * propagation limit to zero, which PicoSAT checks in its main loop.  Both
+ * happen under the lock 'mgr->cancel_lock' of the canceller, under which
+ * the solving thread checks the flag and sets its own limit right before
+ * solving.  Thus cancellation is neither lost nor overwritten, and PicoSAT
+ * is only interrupted while 'solving', but never while clauses are added.
+ * The limit 'mgr->limit' is on propagations.
+ */
+#ifdef LIMBOOLE_USE_PICOSAT
+
+static int
+solve_picosat (Mgr * mgr)
+{
+  int cancelled, res;
+
+#ifdef LIMBOOLE_USE_THREADS
+  if (mgr->cancel_lock)
+    pthread_mutex_lock (mgr->cancel_lock);
+#endif
+  cancelled = mgr->cancel && *mgr->cancel;
+  if (!cancelled)
+    picosat_set_propagation_limit (mgr->picosat,
+				   mgr->limit ? mgr->limit : ~0ull);
+#ifdef LIMBOOLE_USE_THREADS
+  mgr->solving = !cancelled;
+  if (mgr->cancel_lock)
+    pthread_mutex_unlock (mgr->cancel_lock);
+#endif
+  if (cancelled)
+    return 0;
+
+  res = picosat_sat (mgr->picosat, -1);
+
+#ifdef LIMBOOLE_USE_THREADS
+  if (mgr->cancel_lock)
+    pthread_mutex_lock (mgr->cancel_lock);
+  mgr->solving = 0;
+  if (mgr->cancel_lock)
+    pthread_mutex_unlock (mgr->cancel_lock);
+#endif
+
+  return res;
+}
+
+#ifdef LIMBOOLE_USE_THREADS
+
+/* Needs the lock of the canceller and only interrupts a solving PicoSAT.
+ */
+static void
+cancel_picosat (PicoSAT * picosat, int solving)
+{
+  if (solving)
+    picosat_set_propagation_limit (picosat, 0);
+}
+
+#endif
+#endif
+/*------------------------------------------------------------------------*/
+#ifdef LIMBOOLE_RACE
+/* With '--race' propositional formulas are encoded once into 'mgr->cnf'
+ * and solved by PicoSAT in the calling thread and by DepQBF, with all
+ * variables in one existential scope, in a detached thread, which loads a
+ * copy of the encoding, since loading DepQBF takes long.  The first
+ * definite answer wins, and the assignment is printed from the winner.
+ * DepQBF has no interrupt hook, thus it solves incrementally in slices of
+ * decisions, which double in size from 'RACE_SLICE' to keep the overhead
+ * of restarting it low.  If PicoSAT wins, it does not wait for the slice
+ * to end, and DepQBF deletes itself afterwards.  The last one to leave the
+ * race releases it.  While racing, 'mgr->cancel' is the flag 'done' of the
+ * race, since '--serve' does not race.
+ */
+#define RACE_SLICE 10000
+#define RACE_CHECK 1024		/* clauses loaded between checks */
+
+typedef struct Race Race;
+
+struct Race
+{
+  QDPLL *qdpll;			/* owned by the thread until it wins */
+  Nesting outer;		/* scope of all variables */
+  int num_vars;
+  int *lits;			/* copy of the encoding loaded by the thread */
+  size_t count;
+  Mgr *mgr;			/* of PicoSAT until it left the race */
+  volatile int done;		/* cancels PicoSAT */
+  const char *winner;
+  int res;			/* of the winner */
+  int refs;			/* calling thread and DepQBF thread */
+  pthread_mutex_t lock;
+};
+
+/*------------------------------------------------------------------------*/
+/* Returns non zero if 'name' wins.  Needs the lock of the race.
+ */
+static int
+finish_race (Race * race, const char *name, int res)
+{
+  if (race->winner || !res)
+    return 0;
+
+  race->winner = name;
+  race->res = res;
+  race->done = 1;
+  if (race->mgr)
+    cancel_picosat (race->mgr->picosat, race->mgr->solving);
+
+  return 1;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+leave_race (Race * race)
+{
+  int refs;
+
+  pthread_mutex_lock (&race->lock);
+  refs = --race->refs;
+  pthread_mutex_unlock (&race->lock);
+
+  if (refs)
+    return;
+
+  pthread_mutex_destroy (&race->lock);
+  free (race->lits);
+  free (race);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void *
+race_depqbf (void *arg)
+{
+  int limit, slice, done, res, idx;
+  unsigned clauses;
+  char option[32];
+  const int *p;
+  Race *race;
+
+  race = (Race *) arg;
+  race->outer = qdpll_new_scope (race->qdpll, QDPLL_QTYPE_EXISTS);
+  for (idx = 1; idx <= race->num_vars; idx++)
+    qdpll_add (race->qdpll, idx);
+  qdpll_add (race->qdpll, 0);
+
+  done = 0;
+  clauses = 0;
+  for (p = race->lits; !done && p < race->lits + race->count; p++)
+    {
+      qdpll_add (race->qdpll, *p);
+      if (*p || ++clauses % RACE_CHECK)
+	continue;
+      pthread_mutex_lock (&race->lock);
+      done = race->done;
+      pthread_mutex_unlock (&race->lock);
+    }
+
+  limit = 0;
+  slice = RACE_SLICE;
+  pthread_mutex_lock (&race->lock);
+  done = race->done ? -1 : 0;
+  pthread_mutex_unlock (&race->lock);
+
+  while (!done)
+    {
+      if (limit)
+	qdpll_reset (race->qdpll);
+      if (limit < INT_MAX / 4)
+	{
+	  limit += slice;
+	  slice *= 2;
+	  sprintf (option, "--max-dec=%d", limit);
+	  qdpll_configure (race->qdpll, option);
+	}
+
+      res = qdpll_sat (race->qdpll);
+
+      pthread_mutex_lock (&race->lock);
+      if (!(done = finish_race (race, "DepQBF", res)) && race->winner)
+	done = -1;
+      pthread_mutex_unlock (&race->lock);
+    }
+
+  if (done < 0)
+    qdpll_delete (race->qdpll);
+  leave_race (race);
+
+  return 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+race (Mgr * mgr)
+{
+  pthread_mutex_t *cancel_lock;
+  volatile int *cancel;
+  pthread_t thread;
+  int res, started;
+  Race *race;
+
+  race = (Race *) malloc (sizeof (*race));
+  memset (race, 0, sizeof (*race));
+  race->qdpll = qdpll_create ();
+  qdpll_configure (race->qdpll, "--no-dynamic-nenofex");
+  qdpll_configure (race->qdpll, "--incremental-use");
+  qdpll_configure (race->qdpll, "--dep-man=simple");
+  race->num_vars = mgr->idx;
+  race->count = mgr->cnf.count;
+  race->lits = (int *) malloc ((race->count + 1) * sizeof (int));
+  memcpy (race->lits, mgr->cnf.lits, race->count * sizeof (int));
+  race->mgr = mgr;
+  race->refs = 2;
+  pthread_mutex_init (&race->lock, 0);
+
+  cancel = mgr->cancel;
+  cancel_lock = mgr->cancel_lock;
+  mgr->cancel = &race->done;
+  mgr->cancel_lock = &race->lock;
+  if ((started = !pthread_create (&thread, 0, race_depqbf, race)))
+    pthread_detach (thread);
+  else
+    {
+      qdpll_delete (race->qdpll);
+      race->refs = 1;
+    }
+
+  picosat_add_clauses (mgr, mgr->cnf.lits, mgr->cnf.count);
+  res = solve_picosat (mgr);
+  mgr->cancel = cancel;
+  mgr->cancel_lock = cancel_lock;
+
+  pthread_mutex_lock (&race->lock);
+  race->mgr = 0;
+  if (!finish_race (race, "PicoSAT", res) && race->winner)
+    {
+      picosat_reset (mgr->picosat);
+      mgr->picosat = 0;
+      mgr->qdpll = race->qdpll;
+      mgr->outer = mgr->inner = race->outer;
+      res = race->res;
+    }
+  else
+    {
+      race->winner = "PicoSAT";	/* DepQBF gives up after its slice */
+      race->done = 1;
+    }
+  pthread_mutex_unlock (&race->lock);
+
+  if (mgr->verbose)
+    fprintf (mgr->log, "c race won by %s\n",
+	     mgr->picosat ? "PicoSAT" : "DepQBF");
+
+  leave_race (race);
+
+  return res;
+}
+
+#endif
+/*------------------------------------------------------------------------*/
+#ifdef LIMBOOLE_PORTFOLIO
+/* With '--threads' propositional formulas are encoded once into 'mgr->cnf',
+ * which every PicoSAT instance of the portfolio loads in its own thread.
+ * The calling thread solves with 'mgr->picosat' in the default
+ * configuration, while the other instances differ in the seed for random
+ * decisions and in the initial phase.  The first definite answer cancels
+ * the other instances, and the winner replaces 'mgr->picosat' to print the
+ * assignment.  The flag 'mgr->cancel' is only checked before and after
+ * solving, since '--serve' does not run portfolios.
+ */
+#define PORTFOLIO_CHECK 1024	/* clauses loaded between checks */
+
+typedef struct Portfolio Portfolio;
+typedef struct Instance Instance;
+
+struct Instance
+{
+  Portfolio *portfolio;
+  PicoSAT *picosat;
+  pthread_t thread;
+  int started;
+  int solving;			/* may be interrupted */
+  int res;
+};
+
+struct Portfolio
+{
+  Mgr *mgr;			/* shared encoding, limit and cancel flag */
+  Instance *instances;
+  int size;
+  int done;			/* cancels instances not yet solving */
+  int winner;			/* index into 'instances' or -1 */
+  pthread_mutex_t lock;
+};
+
+/*------------------------------------------------------------------------*/
+/* Initial phases of the instances, where the first is the default one.
+ */
+static const int portfolio_phases[] = { 2, 0, 1, 3 };
+
+static PicoSAT *
+new_instance (Mgr * mgr, int idx)
+{
+  PicoSAT *res;
+
+  res = picosat_init ();
+  picosat_set_prefix (res, "c PicoSAT ");
+  picosat_set_output (res, mgr->log);
+  picosat_set_seed (res, (unsigned) idx);
+  picosat_set_global_default_phase (res, portfolio_phases[idx % 4]);
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+/* As in 'solve_picosat' the winner sets 'done' and interrupts the solving
+ * instances under the lock of the portfolio, under which instances check
+ * 'done' and set their own limit before solving.
+ */
+static void
+solve_instance (Instance * instance)
+{
+  Portfolio *portfolio;
+  volatile int *cancel;
+  const int *p, *end;
+  unsigned clauses;
+  int i, res, done;
+  Mgr *mgr;
+
+  portfolio = instance->portfolio;
+  mgr = portfolio->mgr;
+  cancel = mgr->cancel;
+
+  done = 0;
+  clauses = 0;
+  end = mgr->cnf.lits + mgr->cnf.count;
+  for (p = mgr->cnf.lits; !done && p < end; p++)
+    {
+      picosat_add_lits (instance->picosat, (int *) p);
+      while (*p)
+	p++;
+      if (++clauses % PORTFOLIO_CHECK)
+	continue;
+      pthread_mutex_lock (&portfolio->lock);
+      done = portfolio->done;
+      pthread_mutex_unlock (&portfolio->lock);
+    }
+
+  pthread_mutex_lock (&portfolio->lock);
+  instance->solving = !portfolio->done && !(cancel && *cancel);
+  if (instance->solving)
+    picosat_set_propagation_limit (instance->picosat,
+				   mgr->limit ? mgr->limit : ~0ull);
+  pthread_mutex_unlock (&portfolio->lock);
+
+  res = instance->solving ? picosat_sat (instance->picosat, -1) : 0;
+  instance->res = res;
+
+  pthread_mutex_lock (&portfolio->lock);
+  instance->solving = 0;
+  if (!portfolio->done && (res || (cancel && *cancel)))
+    {
+      if (res)
+	portfolio->winner = instance - portfolio->instances;
+      portfolio->done = 1;
+      for (i = 0; i < portfolio->size; i++)
+	cancel_picosat (portfolio->instances[i].picosat,
+			portfolio->instances[i].solving);
+    }
+  pthread_mutex_unlock (&portfolio->lock);
+}
+
+static void *
+portfolio_worker (void *arg)
+{
+  solve_instance ((Instance *) arg);
+
+  return 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+portfolio (Mgr * mgr)
+{
+  Portfolio portfolio;
+  Instance *instance;
+  int i, res;
+
+  memset (&portfolio, 0, sizeof (portfolio));
+  portfolio.mgr = mgr;
+  portfolio.size = mgr->portfolio;
+  portfolio.winner = -1;
+  portfolio.instances =
+    (Instance *) calloc (portfolio.size, sizeof (Instance));
+  pthread_mutex_init (&portfolio.lock, 0);
+
+  for (i = 0; i < portfolio.size; i++)
+    {
+      instance = portfolio.instances + i;
+      instance->portfolio = &portfolio;
+      instance->picosat = i ? new_instance (mgr, i) : mgr->picosat;
+    }
+
+  for (i = 1; i < portfolio.size; i++)
+    {
+      instance = portfolio.instances + i;
+      instance->started =
+	!pthread_create (&instance->thread, 0, portfolio_worker, instance);
+    }
+
+  solve_instance (portfolio.instances);
+
+  for (i = 1; i < portfolio.size; i++)
+    if (portfolio.instances[i].started)
+      pthread_join (portfolio.instances[i].thread, 0);
+
+  res = 0;
+  if (portfolio.winner >= 0)
+    {
+      instance = portfolio.instances + portfolio.winner;
+      res = instance->res;
+      portfolio.instances->picosat = instance->picosat;
+      instance->picosat = mgr->picosat;
+      mgr->picosat = portfolio.instances->picosat;
+    }
+
+  for (i = 1; i < portfolio.size; i++)
+    picosat_reset (portfolio.instances[i].picosat);
+
+  if (mgr->verbose && portfolio.winner >= 0)
+    fprintf (mgr->log, "c portfolio won by instance %d of %d\n",
+	     portfolio.winner, portfolio.size);
+
+  pthread_mutex_destroy (&portfolio.lock);
+  free (portfolio.instances);
+
+  return res;
+}
+
+#endif
+/*------------------------------------------------------------------------*/
+/* For DepQBF the limit is on decisions, and cancellation only takes effect
+ * before it starts.  Returns zero if the result is unknown.
+ */
+static int
+solve (Mgr * mgr)
+{
+#ifdef LIMBOOLE_USE_DEPQBF
+  char option[32];
+#endif
+  int res;
+
+  res = 0;
+  if (mgr->cancel && *mgr->cancel)
+    return res;
+
+#ifdef LIMBOOLE_RACE
+  if (mgr->race)
+    return race (mgr);
+#endif
+#ifdef LIMBOOLE_PORTFOLIO
+  if (mgr->portfolio > 1)
+    return portfolio (mgr);
+#endif
+
+#ifdef LIMBOOLE_USE_LINGELING
+  if (mgr->lgl)
+    res = lglsat (mgr->lgl);
+#endif
+#ifdef LIMBOOLE_USE_PICOSAT
+  if (mgr->picosat)
+    res = solve_picosat (mgr);
+#endif
+#ifdef LIMBOOLE_USE_DEPQBF
+  if (mgr->qdpll)
+    {
+      if (mgr->limit)
+	{
+	  sprintf (option, "--max-dec=%d",
+		   mgr->limit < INT_MAX ? (int) mgr->limit : INT_MAX);
+	  qdpll_configure (mgr->qdpll, option);
+	}
+      res = qdpll_sat (mgr->qdpll);
+    }
+#endif
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+/* Returns space for a clause with 'len' literals and its terminating zero
+ * at the end of 'clauses'.
+ */
+static int *
+new_clause (Clauses * clauses, size_t len)
+{
+  int *res;
+
+  while (clauses->size - clauses->count < len + 1)
+    {
+      clauses->size = clauses->size ? 2 * clauses->size : BATCH_SIZE;
+      clauses->lits = (int *) realloc (clauses->lits,
+				       clauses->size * sizeof (int));
+    }
+
+  res = clauses->lits + clauses->count;
+  res[len] = 0;
+  clauses->count += len + 1;
+  clauses->num++;
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+unit_clause (Clauses * clauses, int a)
+{
+  int *clause;
+
+  clause = new_clause (clauses, 1);
+  clause[0] = a;
+}
+
+/*------------------------------------------------------------------------*/
+/* Without 'simplify' gates may have equal or complementary children.  Thus
+ * duplicated literals are removed and tautological clauses are dropped.
+ */
+static void
+binary_clause (Clauses * clauses, int a, int b)
+{
+  int *clause;
+
+  if (a == -b)
+    return;
+
+  if (a == b)
+    {
+      unit_clause (clauses, a);
+      return;
+    }
+
+  clause = new_clause (clauses, 2);
+  clause[0] = a;
+  clause[1] = b;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+ternary_clause (Clauses * clauses, int a, int b, int c)
+{
+  int *clause;
+
+  if (a == -b || a == -c || b == -c)
+    return;
+
+  if (a == b || a == c)
+    {
+      binary_clause (clauses, b, c);
+      return;
+    }
+
+  if (b == c)
+    {
+      binary_clause (clauses, a, b);
+      return;
+    }
+
+  clause = new_clause (clauses, 3);
+  clause[0] = a;
+  clause[1] = b;
+  clause[2] = c;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+push_conjunct (Mgr * mgr, Ref ref)
+{
+  if (mgr->conjuncts_size == mgr->conjuncts_count)
+    {
+      mgr->conjuncts_size =
+	mgr->conjuncts_size ? 2 * mgr->conjuncts_size : 16;
+      mgr->conjuncts = (Ref *) realloc (mgr->conjuncts,
+					mgr->conjuncts_size * sizeof (Ref));
+    }
+
+  mgr->conjuncts[mgr->conjuncts_count++] = ref;
+}
+
+/*------------------------------------------------------------------------*/
+/* Flatten nested conjunctions of the asserted formula 'ref' into its
+ * top-level conjuncts.  Visited conjunctions are marked, since the formula
+ * is a DAG.  Without polarities all gates are defined anyway and 'ref'
+ * remains the only conjunct.
+ */
+static void
+collect_conjuncts (Mgr * mgr, Ref ref)
+{
+  unsigned i, size, pos, id;
+  Ref *refs;
+
+  mgr->conjuncts_count = 0;
+  push_conjunct (mgr, ref);
+
+  if (mgr->dump || mgr->use_depqbf)
+    return;
+
+  pos = 0;
+  while (pos < mgr->conjuncts_count)
+    {
+      ref = mgr->conjuncts[pos];
+      id = node_id (ref);
+      if (is_negated (ref) || mgr->types[id] != AND)
+	{
+	  pos++;
+	  continue;
+	}
+
+      mgr->conjuncts[pos] = mgr->conjuncts[--mgr->conjuncts_count];
+      if (mgr->marks[id])
+	continue;
+      mgr->marks[id] = 1;
+
+      refs = mgr->refs + mgr->child0[id];
+      size = mgr->child1[id];
+      for (i = 0; i < size; i++)
+	push_conjunct (mgr, refs[i]);
+    }
+
+  memset (mgr->marks, 0, mgr->nodes_count + 1);
+}
+
+/*------------------------------------------------------------------------*/
+/* A negated conjunction of variables is a clause over the variables.  As a
+ * top-level conjunct it is added to the solver as is.
+ */
+static int
+is_clause (Mgr * mgr, Ref ref)
+{
+  unsigned i, size, id;
+  Ref *refs;
+
+  id = node_id (ref);
+  if (!is_negated (ref) || mgr->types[id] != AND)
+    return 0;
+
+  refs = mgr->refs + mgr->child0[id];
+  size = mgr->child1[id];
+  for (i = 0; i < size; i++)
+    if (mgr->types[node_id (refs[i])] != VAR)
+      return 0;
+
+  return 1;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+direct_clause (Mgr * mgr, Ref ref)
+{
+  unsigned i, size, id;
+  Ref *refs;
+  int *clause;
+
+  id = node_id (ref);
+  refs = mgr->refs + mgr->child0[id];
+  size = mgr->child1[id];
+
+  clause = new_clause (&mgr->batch, size);
+  for (i = 0; i < size; i++)
+    clause[i] = -lit (mgr, refs[i]);
+}
+
+/*------------------------------------------------------------------------*/
+/* Top-level conjuncts which are equivalences are XOR constraints over the
+ * leaves of 'xor_leaves'.  They are taken out of the conjuncts and kept in
+ * 'xors' as zero terminated rows of signed node IDs, meaning that the XOR
+ * of the literals is true, where an empty row is a conflict.  Gauss-Jordan
+ * elimination over GF(2) on the dense matrix of all rows then finds
+ * conflicts, units and equivalences implied by the XOR constraints
+ * together, which a CDCL solver often misses on parity problems, and adds
+ * them as further rows.  Reduced rows with more literals are dropped, since
+ * elimination tends to make them dense.  Larger matrices are skipped.
+ */
+#define GAUSS_LIMIT (1 << 18)	/* words of the matrix */
+
+static int *
+new_xor (Mgr * mgr, Ref * leaves, unsigned size, int rhs)
+{
+  int *res;
+  unsigned i;
+
+  res = new_clause (&mgr->xors, size);
+  for (i = 0; i < size; i++)
+    res[i] = (int) node_id (leaves[i]);
+  if (size && !rhs)
+    res[0] = -res[0];
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+gauss (Mgr * mgr)
+{
+  unsigned i, j, k, n, rows, cols, words, rank, col, weight, units, eqs;
+  unsigned long long *matrix, *row, *pivot, bit, w;
+  unsigned *columns, *nodes;
+  unsigned char *rhs, tmp;
+  int conflict, *lits;
+  Ref leaves[2];
+  size_t pos;
+
+  for (i = j = 0; i < mgr->conjuncts_count; i++)
+    {
+      if (mgr->types[node_id (mgr->conjuncts[i])] != IFF)
+	{
+	  mgr->conjuncts[j++] = mgr->conjuncts[i];
+	  continue;
+	}
+      k = 1 ^ xor_leaves (mgr, mgr->conjuncts[i]);
+      new_xor (mgr, mgr->leaves, mgr->leaves_count, k);
+    }
+  mgr->conjuncts_count = j;
+
+  rows = mgr->xors.num;
+  if (rows < 2)
+    return;
+
+  columns = (unsigned *) calloc (mgr->nodes_count + 1, sizeof (unsigned));
+  nodes = (unsigned *) malloc (mgr->xors.count * sizeof (unsigned));
+  cols = 0;
+  for (pos = 0; pos < mgr->xors.count; pos++)
+    {
+      k = (unsigned) abs (mgr->xors.lits[pos]);
+      if (k && !columns[k])
+	{
+	  nodes[cols] = k;
+	  columns[k] = ++cols;
+	}
+    }
+
+  words = cols / 64 + 1;
+  if ((size_t) rows * words > GAUSS_LIMIT)
+    {
+      if (mgr->verbose)
+	fprintf (mgr->log,
+		 "c %u XOR constraints over %u variables too large for "
+		 "Gauss-Jordan elimination\n", rows, cols);
+      free (columns);
+      free (nodes);
+      return;
+    }
+
+  matrix = (unsigned long long *) calloc ((size_t) rows * words,
+					  sizeof (unsigned long long));
+  rhs = (unsigned char *) malloc (rows);
+  lits = mgr->xors.lits;
+  for (i = 0; i < rows; i++)
+    {
+      row = matrix + (size_t) i * words;
+      rhs[i] = 1;
+      for (; *lits; lits++)
+	{
+	  if (*lits < 0)
+	    rhs[i] = 0;
+	  k = columns[abs (*lits)] - 1;
+	  row[k / 64] ^= 1ull << (k % 64);
+	}
+      lits++;
+    }
+
+  rank = 0;
+  for (col = 0; col < cols && rank < rows; col++)
+    {
+      k = col / 64;
+      bit = 1ull << (col % 64);
+      for (i = rank; i < rows; i++)
+	if (matrix[(size_t) i * words + k] & bit)
+	  break;
+      if (i == rows)
+	continue;
+
+      pivot = matrix + (size_t) rank * words;
+      if (i != rank)
+	{
+	  row = matrix + (size_t) i * words;
+	  for (j = k; j < words; j++)
+	    {
+	      w = row[j];
+	      row[j] = pivot[j];
+	      pivot[j] = w;
+	    }
+	  tmp = rhs[i];
+	  rhs[i] = rhs[rank];
+	  rhs[rank] = tmp;
+	}
+
+      for (i = 0; i < rows; i++)
+	{
+	  row = matrix + (size_t) i * words;
+	  if (i == rank || !(row[k] & bit))
+	    continue;
+	  for (j = k; j < words; j++)
+	    row[j] ^= pivot[j];
+	  rhs[i] ^= rhs[rank];
+	}
+      rank++;
+    }
+
+  conflict = 0;
+  for (i = rank; i < rows; i++)
+    if (rhs[i])
+      conflict = 1;
+
+  units = eqs = 0;
+  if (conflict)
+    new_xor (mgr, leaves, 0, 1);
+  else
+    for (i = 0; i < rank; i++)
+      {
+	row = matrix + (size_t) i * words;
+	weight = 0;
+	for (j = 0; j < words && weight < 3; j++)
+	  for (w = row[j]; w && weight < 3; w &= w - 1)
+	    {
+	      if (weight < 2)
+		{
+		  n = 0;
+		  while (!(w & (1ull << n)))
+		    n++;
+		  leaves[weight] = nodes[64 * j + n] << 1;
+		}
+	      weight++;
+	    }
+	if (weight > 2)
+	  continue;
+	new_xor (mgr, leaves, weight, rhs[i]);
+	if (weight == 1)
+	  units++;
+	else
+	  eqs++;
+      }
+
+  if (mgr->verbose)
+    fprintf (mgr->log,
+	     "c Gauss-Jordan elimination on %u XOR constraints over %u "
+	     "variables: rank %u, %s, %u units, %u equivalences\n",
+	     rows, cols, rank, conflict ? "inconsistent" : "consistent",
+	     units, eqs);
+
+  free (rhs);
+  free (matrix);
+  free (columns);
+  free (nodes);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+xor_clause (Clauses * clauses, const int *lits, unsigned size)
+{
+  unsigned mask, parity, i;
+  int *clause;
+
+  for (mask = 0; mask < (1u << size); mask++)
+    {
+      parity = 0;
+      for (i = 0; i < size; i++)
+	parity ^= (mask >> i) & 1;
+      if (parity)
+	continue;
+
+      clause = new_clause (clauses, size);
+      for (i = 0; i < size; i++)
+	clause[i] = ((mask >> i) & 1) ? -lits[i] : lits[i];
+    }
+}
+
+/*------------------------------------------------------------------------*/
+/* A row of at most four literals is encoded by the '2^(size-1)' clauses
+ * which exclude the assignments with an even number of true literals.
+ * Longer rows are cut into such pieces with a fresh variable for the XOR
+ * of the first three literals, which replaces them in the rest.
+ */
+static void
+xor_clauses (Mgr * mgr)
+{
+  int *p, *q, *lits, piece[4];
+  unsigned size;
+
+  for (p = mgr->xors.lits; p < mgr->xors.lits + mgr->xors.count; p = q + 1)
+    {
+      for (q = p; *q; q++)
+	*q = *q < 0 ? -mgr->idxs[-*q] : mgr->idxs[*q];
+
+      lits = p;
+      size = (unsigned) (q - p);
+      while (size > 4)
+	{
+	  piece[0] = lits[0];
+	  piece[1] = lits[1];
+	  piece[2] = lits[2];
+	  piece[3] = -++mgr->idx;
+	  xor_clause (&mgr->batch, piece, 4);
+	  lits += 2;
+	  lits[0] = mgr->idx;
+	  size -= 2;
+	}
+      xor_clause (&mgr->batch, lits, size);
+    }
+}
+
+/*------------------------------------------------------------------------*/
+/* The Plaisted-Greenbaum encoding only defines gates in the directions in
+ * which they are used.  A gate occurring only positively just implies its
+ * definition, one occurring only negatively is just implied by it.  The
+ * top-level conjuncts occur positively, except for clauses, which are added
+ * directly and do not need gates, and the leaves of XOR constraints occur
+ * in both polarities.  Parents
+ * have larger IDs than their children, thus a single pass in decreasing
+ * order of IDs propagates the polarities of all nodes.
+ */
+#define POSITIVE 1
+#define NEGATIVE 2
+
+static void
+add_polarity (Mgr * mgr, Ref ref, int polarity)
+{
+  if (is_negated (ref))
+    polarity = ((polarity & POSITIVE) << 1) | ((polarity & NEGATIVE) >> 1);
+
+  mgr->polarity[node_id (ref)] |= polarity;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int is_clause (Mgr *, Ref);
+
+static void
+compute_polarities (Mgr * mgr)
+{
+  unsigned id, i, size;
+  int polarity, flipped;
+  Ref *refs;
+
+  mgr->polarity = (unsigned char *) calloc (mgr->nodes_count + 1, 1);
+  for (i = 0; i < mgr->conjuncts_count; i++)
+    if (!is_clause (mgr, mgr->conjuncts[i]))
+      add_polarity (mgr, mgr->conjuncts[i], POSITIVE);
+  for (i = 0; i < mgr->xors.count; i++)
+    if (mgr->xors.lits[i])
+      add_polarity (mgr, (unsigned) abs (mgr->xors.lits[i]) << 1,
+		    POSITIVE | NEGATIVE);
+
+  for (id = mgr->nodes_count; id; id--)
+    {
+      if (!(polarity = mgr->polarity[id]))
+	continue;
+
+      flipped = ((polarity & POSITIVE) << 1) | ((polarity & NEGATIVE) >> 1);
+
+      switch (mgr->types[id])
+	{
+	case AND:
+	case OR:
+	  refs = mgr->refs + mgr->child0[id];
+	  size = mgr->child1[id];
+	  for (i = 0; i < size; i++)
+	    add_polarity (mgr, refs[i], polarity);
+	  break;
+	case IMPLIES:
+	  add_polarity (mgr, mgr->child0[id], flipped);
+	  add_polarity (mgr, mgr->child1[id], polarity);
+	  break;
+	case SEILPMI:
+	  add_polarity (mgr, mgr->child0[id], polarity);
+	  add_polarity (mgr, mgr->child1[id], flipped);
+	  break;
+	case IFF:
+	  add_polarity (mgr, mgr->child0[id], POSITIVE | NEGATIVE);
+	  add_polarity (mgr, mgr->child1[id], POSITIVE | NEGATIVE);
+	  break;
+	case ITE:
+	  refs = mgr->refs + mgr->child0[id];
+	  add_polarity (mgr, refs[0], POSITIVE | NEGATIVE);
+	  add_polarity (mgr, refs[1], polarity);
+	  add_polarity (mgr, refs[2], polarity);
+	  break;
+	default:
+	  assert (mgr->types[id] == VAR || mgr->types[id] == FALSE);
+	  break;
+	}
+    }
+}
+
+/*------------------------------------------------------------------------*/
+/* Without polarities all gates are defined in both directions.
+ */
+static int
+needs (Mgr * mgr, unsigned id, int polarity)
+{
+  return !mgr->polarity || (mgr->polarity[id] & polarity);
+}
+
+/*------------------------------------------------------------------------*/
+/* Children of conjunctions are unique, but without 'simplify' they may
+ * contain a child and its negation, which are adjacent after sorting.
+ */
+static int
+complementary (Ref * refs, unsigned size)
+{
+  unsigned i;
+  Ref *sorted;
+  int res;
+
+  if (size == 2)
+    return refs[0] == negate (refs[1]);
+
+  sorted = (Ref *) malloc (size * sizeof (Ref));
+  memcpy (sorted, refs, size * sizeof (Ref));
+  qsort (sorted, size, sizeof (Ref), cmp_refs);
+
+  res = 0;
+  for (i = 1; !res && i < size; i++)
+    res = sorted[i] == negate (sorted[i - 1]);
+
+  free (sorted);
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+/* The gate 'id' of an AND (sign 1) or OR (sign -1) with 'n' children is
+ * defined by 'n' binary clauses and one clause of length 'n + 1', which is
+ * a tautology if two children are complementary.
+ */
+static void
+nary_clauses (Mgr * mgr, Clauses * clauses, unsigned id, int sign)
+{
+  unsigned i, size;
+  int lhs, *clause;
+  Ref *refs;
+
+  lhs = mgr->idxs[id];
+  refs = mgr->refs + mgr->child0[id];
+  size = mgr->child1[id];
+
+  if (needs (mgr, id, sign > 0 ? POSITIVE : NEGATIVE))
+    for (i = 0; i < size; i++)
+      binary_clause (clauses, -sign * lhs, sign * lit (mgr, refs[i]));
+
+  if (!needs (mgr, id, sign > 0 ? NEGATIVE : POSITIVE))
+    return;
+
+  if (!mgr->simplify && complementary (refs, size))
+    return;
+
+  clause = new_clause (clauses, size + 1);
+  clause[0] = sign * lhs;
+  for (i = 0; i < size; i++)
+    clause[i + 1] = -sign * lit (mgr, refs[i]);
+}
+
+/*------------------------------------------------------------------------*/
+/* An ITE gate is defined by two clauses in each direction.  The full
+ * encoding adds the two redundant clauses '(-lhs, t, e)' and '(lhs, -t, -e)'
+ * which help propagation when both branches have the same value.  Without
+ * 'simplify' the branches may be equal, where the gate is equivalent to
+ * 't', or complementary, where it is 'c <-> t' and the redundant clauses
+ * are tautologies.
+ */
+static void
+ite_clauses (Mgr * mgr, Clauses * clauses, unsigned id)
+{
+  int lhs, c, t, e;
+  Ref *refs;
+
+  lhs = mgr->idxs[id];
+  refs = mgr->refs + mgr->child0[id];
+  c = lit (mgr, refs[0]);
+  t = lit (mgr, refs[1]);
+  e = lit (mgr, refs[2]);
+
+  if (t == e)
+    {
+      if (needs (mgr, id, POSITIVE))
+	binary_clause (clauses, -lhs, t);
+      if (needs (mgr, id, NEGATIVE))
+	binary_clause (clauses, lhs, -t);
+      return;
+    }
+
+  if (needs (mgr, id, POSITIVE))
+    {
+      ternary_clause (clauses, -lhs, -c, t);
+      ternary_clause (clauses, -lhs, c, e);
+    }
+
+  if (needs (mgr, id, NEGATIVE))
+    {
+      ternary_clause (clauses, lhs, -c, -t);
+      ternary_clause (clauses, lhs, c, -e);
+    }
+
+  if (!mgr->polarity && t != -e)
+    {
+      ternary_clause (clauses, -lhs, t, e);
+      ternary_clause (clauses, lhs, -t, -e);
+    }
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+binary_gate_clauses (Mgr * mgr, Clauses * clauses, unsigned id)
+{
+  int lhs, a, b, pos, neg;
+
+  lhs = mgr->idxs[id];
+  a = lit (mgr, mgr->child0[id]);
+  b = lit (mgr, mgr->child1[id]);
+  pos = needs (mgr, id, POSITIVE);
+  neg = needs (mgr, id, NEGATIVE);
+
+  switch (mgr->types[id])
+    {
+    case IFF:
+      if (neg)
+	{
+	  ternary_clause (clauses, lhs, -a, -b);
+	  ternary_clause (clauses, lhs, a, b);
+	}
+      if (pos)
+	{
+	  ternary_clause (clauses, -lhs, -a, b);
+	  ternary_clause (clauses, -lhs, a, -b);
+	}
+      break;
+    case IMPLIES:
+      if (neg)
+	{
+	  binary_clause (clauses, lhs, a);
+	  binary_clause (clauses, lhs, -b);
+	}
+      if (pos)
+	ternary_clause (clauses, -lhs, -a, b);
+      break;
+    default:
+      assert (mgr->types[id] == SEILPMI);
+      if (neg)
+	{
+	  binary_clause (clauses, lhs, -a);
+	  binary_clause (clauses, lhs, b);
+	}
+      if (pos)
+	ternary_clause (clauses, -lhs, a, -b);
+      break;
+    }
+}
+
+/*------------------------------------------------------------------------*/
+/* Binary and ITE gates are degenerate if two of their children are on the
+ * same variable, which only happens without 'simplify'.
+ */
+static int
+degenerate (Mgr * mgr, unsigned id)
+{
+  int a, b, c;
+  Ref *refs;
+
+  if (mgr->types[id] != ITE)
+    {
+      a = abs (lit (mgr, mgr->child0[id]));
+      b = abs (lit (mgr, mgr->child1[id]));
+      return a == b;
+    }
+
+  refs = mgr->refs + mgr->child0[id];
+  a = abs (lit (mgr, refs[0]));
+  b = abs (lit (mgr, refs[1]));
+  c = abs (lit (mgr, refs[2]));
+
+  return a == b || a == c || b == c;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+same_clause (const int *a, const int *b)
+{
+  const int *p, *q;
+  unsigned m, n;
+
+  for (m = 0; a[m]; m++)
+    ;
+  for (n = 0; b[n]; n++)
+    ;
+  if (m != n)
+    return 0;
+
+  for (p = a; *p; p++)
+    {
+      for (q = b; *q && *q != *p; q++)
+	;
+      if (!*q)
+	return 0;
+    }
+
+  return 1;
+}
+
+/*------------------------------------------------------------------------*/
+/* After removing duplicated literals the clauses of a degenerate gate may
+ * coincide, e.g. 'a -> !a' gives '(lhs, a)' twice.  Only the first of the
+ * equal clauses starting at 'start' is kept.
+ */
+static void
+remove_duplicates (Clauses * clauses, size_t start)
+{
+  int *p, *q, *k, *end, *dst;
+  size_t len;
+
+  end = clauses->lits + clauses->count;
+  dst = clauses->lits + start;
+  for (p = dst; p < end; p = q + 1)
+    {
+      for (q = p; *q; q++)
+	;
+
+      for (k = clauses->lits + start; k < dst; k++)
+	{
+	  if (same_clause (k, p))
+	    break;
+	  while (*k)
+	    k++;
+	}
+
+      if (k < dst)
+	{
+	  clauses->num--;
+	  continue;
+	}
+
+      len = (size_t) (q - p) + 1;
+      memmove (dst, p, len * sizeof (int));
+      dst += len;
+    }
+
+  clauses->count = (size_t) (dst - clauses->lits);
+}
+
+/*------------------------------------------------------------------------*/
+/* The clauses of a gate only depend on its own and its children's indices,
+ * thus gates can be encoded in any order and in parallel.
+ */
+static void
+encode_gate (Mgr * mgr, Clauses * clauses, unsigned id)
+{
+  size_t start;
+
+  if (mgr->types[id] == VAR || !mgr->idxs[id])
+    return;
+
+  if (is_nary (mgr->types[id]))
+    {
+      nary_clauses (mgr, clauses, id, mgr->types[id] == AND ? 1 : -1);
+      return;
+    }
+
+  if (mgr->types[id] == FALSE)
+    {
+      if (needs (mgr, id, POSITIVE))
+	unit_clause (clauses, -mgr->idxs[id]);
+      return;
+    }
+
+  start = clauses->count;
+  if (mgr->types[id] == ITE)
+    ite_clauses (mgr, clauses, id);
+  else
+    binary_gate_clauses (mgr, clauses, id);
+
+  if (degenerate (mgr, id))
+    remove_duplicates (clauses, start);
+}
+
+/*------------------------------------------------------------------------*/
+/* Number of clauses 'encode_gate' produces for 'id', which the header of
+ * dumps needs before any clause is written.  Only degenerate gates are
+ * encoded to count them, into the otherwise empty 'batch'.
+ */
+static unsigned
+gate_clauses (Mgr * mgr, unsigned id)
+{
+  unsigned res, size;
+  int pos, neg, sign;
+  Type type;
+
+  type = mgr->types[id];
+  if (type == VAR || !mgr->idxs[id])
+    return 0;
+
+  pos = needs (mgr, id, POSITIVE);
+  neg = needs (mgr, id, NEGATIVE);
+
+  if (is_nary (type))
+    {
+      sign = type == AND ? 1 : -1;
+      size = mgr->child1[id];
+      res = 0;
+      if (sign > 0 ? pos : neg)
+	res += size;
+      if ((sign > 0 ? neg : pos)
+	  && (mgr->simplify
+	      || !complementary (mgr->refs + mgr->child0[id], size)))
+	res++;
+      return res;
+    }
+
+  if (type == FALSE)
+    return (unsigned) pos;
+
+  if (degenerate (mgr, id))
+    {
+      assert (!mgr->batch.count);
+      encode_gate (mgr, &mgr->batch, id);
+      res = mgr->batch.num;
+      mgr->batch.count = mgr->batch.num = 0;
+      return res;
+    }
+
+  switch (type)
+    {
+    case ITE:
+      return 2 * pos + 2 * neg + (mgr->polarity ? 0 : 2);
+    case IFF:
+      return 2 * pos + 2 * neg;
+    default:
+      assert (type == IMPLIES || type == SEILPMI);
+      return pos + 2 * neg;
+    }
+}
+
+/*------------------------------------------------------------------------*/
+#ifdef LIMBOOLE_USE_THREADS
+/* With '-j' the node IDs are split into consecutive chunks, which threads
+ * encode into their own clauses.  The main thread adds the chunks in order
+ * as soon as they are encoded, thus the clauses and their order are the
+ * same as for sequential encoding.  Threads only encode a few chunks ahead
+ * of the main thread, which keeps memory bounded and lets solvers and '-d'
+ * consume the clauses while the rest is encoded.  Small formulas are not
+ * worth starting threads and are encoded sequentially.
+ */
+#define ENCODE_CHUNK (1 << 14)	/* nodes per chunk */
+#define ENCODE_AHEAD 4		/* chunks per thread encoded ahead */
+
+typedef struct Chunk Chunk;
+typedef struct Encoder Encoder;
+
+struct Chunk
+{
+  Clauses clauses;
+  int done;
+};
+
+struct Encoder
+{
+  Mgr *mgr;
+  Chunk *chunks;
+  unsigned num_chunks;
+  unsigned next;		/* chunk to be encoded next */
+  unsigned added;		/* chunks added by the main thread */
+  unsigned ahead;		/* chunks encoded but not added yet */
+  pthread_mutex_t lock;
+  pthread_cond_t changed;	/* signalled on encoded and added chunks */
+};
+
+/*------------------------------------------------------------------------*/
+
+static void *
+encode_chunks (void *arg)
+{
+  unsigned k, id, last;
+  Encoder *encoder;
+  Chunk *chunk;
+  Mgr *mgr;
+
+  encoder = (Encoder *) arg;
+  mgr = encoder->mgr;
+  for (;;)
+    {
+      pthread_mutex_lock (&encoder->lock);
+      while (encoder->next < encoder->num_chunks
+	     && encoder->next >= encoder->added + encoder->ahead)
+	pthread_cond_wait (&encoder->changed, &encoder->lock);
+      k = encoder->next++;
+      pthread_mutex_unlock (&encoder->lock);
+      if (k >= encoder->num_chunks)
+	break;
+
+      chunk = encoder->chunks + k;
+      last = k + 1 < encoder->num_chunks ?
+	(k + 1) * ENCODE_CHUNK : mgr->nodes_count;
+      for (id = k * ENCODE_CHUNK + 1; id <= last; id++)
+	encode_gate (mgr, &chunk->clauses, id);
+
+      pthread_mutex_lock (&encoder->lock);
+      chunk->done = 1;
+      pthread_cond_broadcast (&encoder->changed);
+      pthread_mutex_unlock (&encoder->lock);
+    }
+
+  return 0;
+}
+
+/*------------------------------------------------------------------------*/
+/* Returns zero if the formula is too small or no thread could be started.
+ */
+static int
+encode_parallel (Mgr * mgr)
+{
+  unsigned num_workers, started, k;
+  pthread_t *workers;
+  Encoder encoder;
+  Chunk *chunk;
+
+  if (mgr->threads < 2)
+    return 0;
+
+  memset (&encoder, 0, sizeof (encoder));
+  encoder.num_chunks = (mgr->nodes_count + ENCODE_CHUNK - 1) / ENCODE_CHUNK;
+  if (encoder.num_chunks < 2 * (unsigned) mgr->threads)
+    return 0;
+
+  num_workers = (unsigned) mgr->threads;
+  encoder.mgr = mgr;
+  encoder.ahead = ENCODE_AHEAD * num_workers;
+  encoder.chunks = (Chunk *) calloc (encoder.num_chunks, sizeof (Chunk));
+  pthread_mutex_init (&encoder.lock, 0);
+  pthread_cond_init (&encoder.changed, 0);
+
+  workers = (pthread_t *) malloc (num_workers * sizeof (pthread_t));
+  for (started = 0; started < num_workers; started++)
+    if (pthread_create (workers + started, 0, encode_chunks, &encoder))
+      break;
+
+  if (started)
+    {
+      add_clauses (mgr, &mgr->batch);
+
+      for (k = 0; k < encoder.num_chunks; k++)
+	{
+	  chunk = encoder.chunks + k;
+	  pthread_mutex_lock (&encoder.lock);
+	  while (!chunk->done)
+	    pthread_cond_wait (&encoder.changed, &encoder.lock);
+	  pthread_mutex_unlock (&encoder.lock);
+
+	  add_clauses (mgr, &chunk->clauses);
+	  free (chunk->clauses.lits);
+
+	  pthread_mutex_lock (&encoder.lock);
+	  encoder.added++;
+	  pthread_cond_broadcast (&encoder.changed);
+	  pthread_mutex_unlock (&encoder.lock);
+	}
+    }
+
+  for (k = 0; k < started; k++)
+    pthread_join (workers[k], 0);
+  free (workers);
+
+  pthread_cond_destroy (&encoder.changed);
+  pthread_mutex_destroy (&encoder.lock);
+  free (encoder.chunks);
+
+  if (started && mgr->verbose)
+    fprintf (mgr->log, "c encoded %u nodes in %u chunks with %u threads\n",
+	     mgr->nodes_count, encoder.num_chunks, started);
+
+  return started > 0;
+}
+
+#else
+
+static int
+encode_parallel (Mgr * mgr)
+{
+  (void) mgr;
+  return 0;
+}
+
+#endif
+/*------------------------------------------------------------------------*/
+/* Comment with the index and name of a variable.
+ */
+static void
+dump_var (Mgr * mgr, unsigned id)
+{
+  dump_string (mgr, "c ");
+  dump_int (mgr, mgr->idxs[id], ' ');
+  dump_string (mgr, var_name (mgr, id));
+  dump_string (mgr, "\n");
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+dump_quantified (Mgr * mgr, int *quantifier, int q, int idx)
+{
+  if (*quantifier != q)
+    {
+      if (*quantifier)
+	dump_string (mgr, "0\n");
+      dump_string (mgr, q == ALL ? "a " : "e ");
+      *quantifier = q;
+    }
+
+  dump_int (mgr, idx, ' ');
+}
+
+/*------------------------------------------------------------------------*/
+/* QDIMACS dumps get the quantifier prefix directly from 'first_prefix'
+ * with the scopes which 'declare_prefix' and 'tseitin' give to DepQBF.
+ * The outermost scope is existential with '-s' and universal otherwise.
+ * It contains the free variables and a leading existential block of the
+ * prefix.  Tseitin variables are in the innermost existential scope, which
+ * is the outermost one if the prefix has no universal variables.  Adjacent
+ * scopes of the same kind are merged.
+ */
+static void
+dump_prefix (Mgr * mgr)
+{
+  int quantifier, outer, inner_is_outer, prefixed, idx;
+  PNode *p;
+
+  outer = mgr->check_satisfiability ? EX : ALL;
+  inner_is_outer = 1;
+  prefixed = 0;
+  for (p = mgr->first_prefix; p; p = p->next)
+    {
+      if (p->type == ALL)
+	inner_is_outer = 0;
+      prefixed++;
+    }
+
+  quantifier = 0;
+  for (p = mgr->first_prefix; p && p->type == EX; p = p->next)
+    dump_quantified (mgr, &quantifier, outer, mgr->idxs[p->node]);
+  for (idx = prefixed + 1; idx <= mgr->idx; idx++)
+    if (inner_is_outer || mgr->types[mgr->idx2node[idx]] == VAR)
+      dump_quantified (mgr, &quantifier, outer, idx);
+
+  for (; p; p = p->next)
+    dump_quantified (mgr, &quantifier, p->type, mgr->idxs[p->node]);
+
+  if (!inner_is_outer)
+    for (idx = prefixed + 1; idx <= mgr->idx; idx++)
+      if (mgr->types[mgr->idx2node[idx]] != VAR)
+	dump_quantified (mgr, &quantifier, EX, idx);
+
+  if (quantifier)
+    dump_string (mgr, "0\n");
+}
+
+/*------------------------------------------------------------------------*/
+/* Negations are not encoded by gates but by the sign of literals.  Both
+ * passes visit nodes in the order of their IDs and thus stream through the
+ * node arrays.  Solving SAT and validity checks uses the Plaisted-Greenbaum
+ * encoding, while dumping with '-d' and QBF keep the full encoding.
+ */
+static void
+tseitin (Mgr * mgr)
+{
+  unsigned id, i, direct;
+  int sign;
+  int num_clauses;
+  PNode *p;
+  Ref ref;
+
+  num_clauses = 0;
+
+  sign = (mgr->check_satisfiability) ? 1 : -1;
+  if(mgr->use_depqbf) sign = 1;
+
+  assert (mgr->root);
+  select_backend (mgr);
+  collect_conjuncts (mgr, sign > 0 ? mgr->root : negate (mgr->root));
+
+  if (!mgr->dump && !mgr->use_depqbf)
+    {
+      gauss (mgr);
+      compute_polarities (mgr);
+    }
+
+  if (mgr->qdump)
+    for (p = mgr->first_prefix; p; p = p->next)
+      dump_var (mgr, p->node);
+
+  for (id = 1; id <= mgr->nodes_count; id++) {
+    if (!mgr->idxs[id]
+        && (mgr->types[id] == VAR || needs (mgr, id, POSITIVE | NEGATIVE))) {
+      mgr->idxs[id] = ++mgr->idx;
+
+#ifdef LIMBOOLE_USE_DEPQBF
+      if(mgr->qdpll) {
+        if (mgr->types[id] == VAR) {
+          qdpll_add_var_to_scope(mgr->qdpll, mgr->idxs[id], mgr->outer);
+          mgr->free_vars = 1;
+        } else {
+          qdpll_add_var_to_scope(mgr->qdpll, mgr->idxs[id], mgr->inner);
+        }
+      }
+#endif
+      if (mgr->dump && mgr->types[id] == VAR)
+        dump_var (mgr, id);
+    }
+
+    if (mgr->dump)
+      num_clauses += gate_clauses (mgr, id);
+  }
+
+  xor_clauses (mgr);
+
+  mgr->idx2node = (unsigned *) calloc (mgr->idx + 1, sizeof (unsigned));
+  for (id = 1; id <= mgr->nodes_count; id++)
+    if (mgr->idxs[id])
+      mgr->idx2node[mgr->idxs[id]] = id;
+
+  if (mgr->dump)
+    {
+      dump_string (mgr, "p cnf ");
+      dump_int (mgr, mgr->idx, ' ');
+      dump_int (mgr, num_clauses + 1, '\n');
+      if (mgr->qdump)
+	dump_prefix (mgr);
+    }
+
+  if (!encode_parallel (mgr))
+    for (id = 1; id <= mgr->nodes_count; id++)
+      {
+	encode_gate (mgr, &mgr->batch, id);
+	if (mgr->batch.count >= BATCH_SIZE)
+	  add_clauses (mgr, &mgr->batch);
+      }
+
+  direct = 0;
+  for (i = 0; i < mgr->conjuncts_count; i++)
+    {
+      ref = mgr->conjuncts[i];
+      if (mgr->polarity && is_clause (mgr, ref))
+	{
+	  direct_clause (mgr, ref);
+	  direct++;
+	}
+      else
+	unit_clause (&mgr->batch, lit (mgr, ref));
+    }
+
+  add_clauses (mgr, &mgr->batch);
+  if (mgr->dump)
+    flush_dump (mgr);
+
+  if (mgr->verbose)
+    {
+      fprintf (mgr->log, "c %u clauses (%s encoding) for %s\n",
+	       mgr->num_clauses,
+	       mgr->polarity ? "Plaisted-Greenbaum" : "full",
+	       mgr->backend->name);
+      fprintf (mgr->log, "c %u of %u top-level conjuncts added as clauses\n",
+	       direct, mgr->conjuncts_count);
+    }
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+pp_aux (Mgr * mgr, Ref ref, Type outer)
+{
+  unsigned i;
+  Type type;
+  int le, lt;
+
+  type = type_of (mgr, ref);
+  le = outer <= type;
+  lt = outer < type;
+
+  switch (type)
+    {
+    case NOT:
+      fputc ('!', mgr->out);
+      pp_aux (mgr, child (mgr, ref, 0), type);
+      break;
+    case IMPLIES:
+    case SEILPMI:
+      if (le)
+	fputc ('(', mgr->out);
+      pp_aux (mgr, child (mgr, ref, 0), type);
+      fputs (type == IMPLIES ? " -> " : " <- ", mgr->out);
+      pp_aux (mgr, child (mgr, ref, 1), type);
+      if (le)
+	fputc (')', mgr->out);
+      break;
+
+    case OR:
+    case AND:
+      if (lt)
+	fputc ('(', mgr->out);
+      for (i = 0; i < size_of (mgr, ref); i++)
+	{
+	  if (i)
+	    fputs (type == OR ? " | " : " & ", mgr->out);
+	  pp_aux (mgr, children (mgr, ref)[i], type);
+	}
+      if (lt)
+	fputc (')', mgr->out);
+      break;
+
+    case IFF:
+      if (lt)
+	fputc ('(', mgr->out);
+      pp_aux (mgr, child (mgr, ref, 0), type);
+      fputs (" <-> ", mgr->out);
+      pp_aux (mgr, child (mgr, ref, 1), type);
+      if (lt)
+	fputc (')', mgr->out);
+      break;
+
+    case ITE:
+      if (outer != DONE)
+	fputc ('(', mgr->out);
+      pp_aux (mgr, children (mgr, ref)[0], type);
+      fputs (" ? ", mgr->out);
+      pp_aux (mgr, children (mgr, ref)[1], type);
+      fputs (" : ", mgr->out);
+      pp_aux (mgr, children (mgr, ref)[2], DONE);
+      if (outer != DONE)
+	fputc (')', mgr->out);
+      break;
+
+    case ATMOST:
+    case ATLEAST:
+    case EXACTLY:
+      fputs (type == ATMOST ? "atmost" : type == ATLEAST ? "atleast"
+	     : "exactly", mgr->out);
+      fprintf (mgr->out, "(%u; ", bound_of (mgr, ref));
+      for (i = 0; i < size_of (mgr, ref); i++)
+	{
+	  if (i)
+	    fputs (", ", mgr->out);
+	  pp_aux (mgr, children (mgr, ref)[i], DONE);
+	}
+      fputc (')', mgr->out);
+      break;
+
+    default:
+      assert (type == VAR);
+      fprintf (mgr->out, "%s", var_name (mgr, node_id (ref)));
+      break;
+    }
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+pp_and (Mgr * mgr, Ref ref)
+{
+  unsigned i;
+
+  if (type_of (mgr, ref) == AND)
+    {
+      for (i = 0; i < size_of (mgr, ref); i++)
+	{
+	  if (i)
+	    fprintf (mgr->out, "\n&\n");
+	  pp_and (mgr, children (mgr, ref)[i]);
+	}
+    }
+  else
+    pp_aux (mgr, ref, AND);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+pp_or (Mgr * mgr, Ref ref)
+{
+  unsigned i;
+
+  if (type_of (mgr, ref) == OR)
+    {
+      for (i = 0; i < size_of (mgr, ref); i++)
+	{
+	  if (i)
+	    fprintf (mgr->out, "\n|\n");
+	  pp_or (mgr, children (mgr, ref)[i]);
+	}
+    }
+  else
+    pp_aux (mgr, ref, OR);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+pp_and_or (Mgr * mgr, Ref ref, Type outer)
+{
+  assert (outer > AND);
+  assert (outer > OR);
+
+  if (type_of (mgr, ref) == AND)
+    pp_and (mgr, ref);
+  else if (type_of (mgr, ref) == OR)
+    pp_or (mgr, ref);
+  else
+    pp_aux (mgr, ref, outer);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+pp_iff_implies (Mgr * mgr, Ref ref, Type outer)
+{
+  Type type;
+
+  type = type_of (mgr, ref);
+  if (type == IFF || type == IMPLIES)
+    {
+      pp_and_or (mgr, child (mgr, ref, 0), type);
+      fprintf (mgr->out, "\n%s\n", type == IFF ? "<->" : "->");
+      pp_and_or (mgr, child (mgr, ref, 1), type);
+    }
+  else
+    pp_and_or (mgr, ref, outer);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void pp_prefix(Mgr *mgr) {
+  PNode *n;
+
+  for (n = mgr->first_prefix; n; n = n->next) {
+    if (n->type == ALL)
+      fprintf(mgr->out, "#");
+    else
+      fprintf(mgr->out, "?");
+
+    printf("%s ", var_name (mgr, n->node));
+  }
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+pp (Mgr * mgr)
+{
+  assert (mgr->root);
+  pp_prefix (mgr);
+  pp_iff_implies (mgr, mgr->root, DONE);
+  fputc ('\n', mgr->out);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+print_assignment (Mgr * mgr)
+{
+  int idx, val;
+  unsigned id;
+  for (idx = 1; idx <= mgr->idx; idx++)
+    {
+      val = 0;
+#ifdef LIMBOOLE_USE_PICOSAT
+      if (mgr->picosat)
+    val = picosat_deref (mgr->picosat, idx);
+#endif
+#ifdef LIMBOOLE_USE_LINGELING
+      if (mgr->lgl)
+    val = lglderef (mgr->lgl, idx);
+#endif
+#ifdef LIMBOOLE_USE_DEPQBF
+      if (mgr->qdpll) {
+        if (qdpll_get_nesting_of_var(mgr->qdpll, idx) == mgr->outer) {
+          val = qdpll_get_value(mgr->qdpll, idx);
+        } else {
+          val = 0;
+        }
+      }
+#endif
+      id = mgr->idx2node[idx];
+      if ((mgr->types[id] == VAR) && (!mgr->qdpll || (mgr->qdpll && val != 0)))
+        fprintf(mgr->out, "%s = %d\n", var_name (mgr, id), val > 0);
+  }
+}
+
+/*------------------------------------------------------------------------*/
+/* Sessions keep one manager with its node store and PicoSAT instance alive
+ * between checks.  Formulas are parsed with 'simplify' right into the
+ * normalized node store, where they share nodes with earlier formulas.
+ * Only nodes without a variable are encoded, thus every check just encodes
+ * the part of its formula which is new.  Since later formulas may use
+ * them in both polarities, gates are encoded in both directions.  Checks
+ * are only assumptions, thus clauses learned in one check remain valid for
+ * the next.
+ */
+#ifdef LIMBOOLE_USE_PICOSAT
+
+struct LimbooleSession
+{
+  Mgr *mgr;
+  unsigned *nodes;		/* to be encoded */
+  unsigned nodes_size;
+  int sat;			/* last check satisfiable, nothing added since */
+};
+
+/*------------------------------------------------------------------------*/
+
+LimbooleSession *
+limboole_session_new (void)
+{
+  LimbooleSession *res;
+  Mgr *mgr;
+
+  res = (LimbooleSession *) malloc (sizeof (*res));
+  memset (res, 0, sizeof (*res));
+  res->mgr = mgr = init ();
+  mgr->name = "<session>";
+  mgr->use_picosat = 1;
+  mgr->simplify = 1;
+  connect_solver (mgr);
+  select_backend (mgr);
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+session_parse (LimbooleSession * session, const char *formula)
+{
+  Mgr *mgr;
+  int res;
+
+  mgr = session->mgr;
+  mgr->input = (char *) formula;
+  mgr->input_length = strlen (formula);
+  mgr->input_pos = 0;
+  mgr->x = mgr->y = 0;
+  mgr->cardinalities = 0;
+
+  next_token (mgr);
+  res = parse (mgr);
+  mgr->input = 0;
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+session_push (LimbooleSession * session, unsigned *count, Ref ref)
+{
+  unsigned id;
+  Mgr *mgr;
+
+  mgr = session->mgr;
+  id = node_id (ref);
+  if (mgr->idxs[id])
+    return;
+
+  mgr->idxs[id] = ++mgr->idx;
+
+  if (session->nodes_size == *count)
+    {
+      session->nodes_size = session->nodes_size ? 2 * session->nodes_size : 16;
+      session->nodes = (unsigned *) realloc (session->nodes,
+					     session->nodes_size *
+					     sizeof (unsigned));
+    }
+
+  session->nodes[(*count)++] = id;
+}
+
+/*------------------------------------------------------------------------*/
+/* Nodes with a variable have their whole cone encoded already.
+ */
+static int
+session_lit (LimbooleSession * session, Ref ref)
+{
+  unsigned i, j, id, count;
+  Mgr *mgr;
+  Ref *refs;
+
+  mgr = session->mgr;
+  count = 0;
+  session_push (session, &count, ref);
+
+  for (i = 0; i < count; i++)
+    {
+      id = session->nodes[i];
+      switch (mgr->types[id])
+	{
+	case AND:
+	case ITE:
+	  refs = mgr->refs + mgr->child0[id];
+	  for (j = 0; j < mgr->child1[id]; j++)
+	    session_push (session, &count, refs[j]);
+	  break;
+	case IFF:
+	  session_push (session, &count, mgr->child0[id]);
+	  session_push (session, &count, mgr->child1[id]);
+	  break;
+	default:
+	  assert (mgr->types[id] == VAR || mgr->types[id] == FALSE);
+	  break;
+	}
+    }
+
+  for (i = 0; i < count; i++)
+    encode_gate (mgr, &mgr->batch, session->nodes[i]);
+  add_clauses (mgr, &mgr->batch);
+  picosat_adjust (mgr->picosat, mgr->idx);
+
+  return lit (mgr, ref);
+}
+
+/*------------------------------------------------------------------------*/
+
+int
+limboole_session_add_formula (LimbooleSession * session, const char *formula)
+{
+  Mgr *mgr;
+
+  mgr = session->mgr;
+  if (!session_parse (session, formula))
+    return 0;
+
+  session->sat = 0;
+  unit_clause (&mgr->batch, session_lit (session, mgr->root));
+  add_clauses (mgr, &mgr->batch);
+
+  return 1;
+}
+
+/*------------------------------------------------------------------------*/
+
+int
+limboole_session_assume (LimbooleSession * session, const char *formula)
+{
+  Mgr *mgr;
+
+  mgr = session->mgr;
+  if (!session_parse (session, formula))
+    return 0;
+
+  session->sat = 0;
+  picosat_assume (mgr->picosat, session_lit (session, mgr->root));
+
+  return 1;
+}
+
+/*------------------------------------------------------------------------*/
+
+int
+limboole_session_check (LimbooleSession * session, const char *formula,
+			int op)
+{
+  int lit, res;
+  Mgr *mgr;
+
+  mgr = session->mgr;
+  if (formula)
+    {
+      if (!session_parse (session, formula))
+	return 0;
+
+      lit = session_lit (session, mgr->root);
+      picosat_assume (mgr->picosat, op ? lit : -lit);
+    }
+
+  res = picosat_sat (mgr->picosat, -1);
+  session->sat = res == PICOSAT_SATISFIABLE;
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+/* PicoSAT aborts on 'picosat_deref' unless it is in the SAT state, which
+ * adding clauses or assumptions leaves.  Its 'picosat_res' still gives
+ * the result of the last check then, thus the session tracks the state.
+ */
+int
+limboole_session_deref (LimbooleSession * session, const char *name)
+{
+  unsigned *slot, id;
+  size_t len;
+  Mgr *mgr;
+
+  mgr = session->mgr;
+  if (!session->sat || !mgr->symtab_size)
+    return 0;
+
+  len = strlen (name);
+  slot = find_symbol (mgr, name, len, hash_name (name, len));
+  if (!*slot)
+    return 0;			/* not interned by any formula */
+
+  id = mgr->symbols[*slot - 1].node;
+  if (!id || !mgr->idxs[id])
+    return 0;
+
+  return picosat_deref (mgr->picosat, mgr->idxs[id]);
+}
+
+/*------------------------------------------------------------------------*/
+
+void
+limboole_session_free (LimbooleSession * session)
+{
+  release (session->mgr);
+  free (session->nodes);
+  free (session);
+}
+
+#endif
+
+/*------------------------------------------------------------------------*/
+#if defined(LIMBOOLE_USE_PICOSAT) && defined(LIMBOOLE_USE_LINGELING) && defined(LIMBOOLE_USE_DEPQBF)
+#define PICOSAT_USAGE \
+"  --picosat      use PicoSAT as SAT solver back-end (disabled by default)\n"
+#define LINGELING_USAGE \
+"  --lingeling    use Lingeling as SAT solver back-end (default)\n"
+#define DEPQBF_USAGE \
+"  --depqbf       use DepQBF as QBF solver back-end (disabled by default)\n"
+#endif
+
+#if defined(LIMBOOLE_USE_PICOSAT) && defined(LIMBOOLE_USE_LINGELING) && !defined(LIMBOOLE_USE_DEPQBF)
+#define PICOSAT_USAGE \
+"  --picosat      use PicoSAT as SAT solver back-end (disabled by default)\n"
+#define LINGELING_USAGE \
+"  --lingeling    use Lingeling as SAT solver back-end (default)\n"
+#define DEPQBF_USAGE \
+"  --depqbf       no support for DepQBF compiled in\n"
+#endif
+
+#if !defined(LIMBOOLE_USE_PICOSAT) && defined(LIMBOOLE_USE_LINGELING) && defined(LIMBOOLE_USE_DEPQBF)
+#define PICOSAT_USAGE \
+"  --picosat      no support for PicoSAT SAT solver compiled in\n"
+#define LINGELING_USAGE \
+"  --lingeling    using Lingeling (as the only available SAT solver back-end)\n"
+#define DEPQBF_USAGE \
+"  --depqbf       use DepQBF as QBF solver back-end \n"
+#endif
+
+#if !defined(LIMBOOLE_USE_PICOSAT) && defined(LIMBOOLE_USE_LINGELING) && !defined(LIMBOOLE_USE_DEPQBF)
+#define PICOSAT_USAGE \
+"  --picosat      no support for PicoSAT SAT solver compiled in\n"
+#define LINGELING_USAGE \
+"  --lingeling    using Lingeling (as the only available SAT solver back-end)\n"
+#define DEPQBF_USAGE \
+"  --depqbf       no support for DepQBF built in \n"
+#endif
+
+#if defined(LIMBOOLE_USE_PICOSAT) && !defined(LIMBOOLE_USE_LINGELING) && defined(LIMBOOLE_USE_DEPQBF)
+#define PICOSAT_USAGE \
+"  --picosat      using PicoSAT \n"
+#define LINGELING_USAGE \
+"  --lingeling    no support for Lingeling SAT solver compiled in\n"
+#define DEPQBF_USAGE \
+"  --depqbf       use DepQBF as QBF solver back-end\n"
+#endif
+
+#if defined(LIMBOOLE_USE_PICOSAT) && !defined(LIMBOOLE_USE_LINGELING) && !defined(LIMBOOLE_USE_DEPQBF)
+#define PICOSAT_USAGE \
+"  --picosat      using PicoSAT (as the only available SAT solver back-end)\n"
+#define LINGELING_USAGE \
+"  --lingeling    no support for Lingeling SAT solver compiled in\n"
+#define DEPQBF_USAGE \
+"  --depqbf       no support for DepQBF compiled in\n"
+#endif
+
+#if !defined(LIMBOOLE_USE_PICOSAT) && !defined(LIMBOOLE_USE_LINGELING) && defined(LIMBOOLE_USE_DEPQBF)
+#define PICOSAT_USAGE \
+"  --picosat      no support for PicoSAT SAT solver compiled in\n"
+#define LINGELING_USAGE \
+"  --lingeling    no support for Lingeling SAT solver compiled in\n"
+#define DEPQBF_USAGE \
+"  --depqbf       using DepQBF as QBF solver back-end\n"
+#endif
+
+#if !defined(LIMBOOLE_USE_PICOSAT) && !defined(LIMBOOLE_USE_LINGELING) \
+  && !defined(LIMBOOLE_USE_DEPQBF)
+#error "At least one of Lingeling or PicoSAT or DepQBF has to be available!"
+#endif
+
+
+#ifdef LIMBOOLE_USE_THREADS
+#define THREADS_USAGE \
+"  -j <threads>   parse and encode with <threads> threads\n" \
+"                 (or solve that many formulas in parallel with '--batch')\n"
+#else
+#define THREADS_USAGE \
+"  -j <threads>   no support for threads compiled in (ignored)\n"
+#endif
+
+#ifdef LIMBOOLE_PORTFOLIO
+#define PORTFOLIO_USAGE \
+"  --threads <n>  solve with <n> differently seeded PicoSAT instances\n"
+#else
+#define PORTFOLIO_USAGE ""
+#endif
+
+#ifdef LIMBOOLE_RACE
+#define RACE_USAGE \
+"  --race         race PicoSAT against DepQBF on propositional formulas\n"
+#else
+#define RACE_USAGE ""
+#endif
+
+#ifdef LIMBOOLE_USE_SERVE
+#define SERVE_USAGE \
+"  --serve <path> answer requests on the Unix socket <path> (see README)\n"
+#else
+#define SERVE_USAGE ""
+#endif
+
+#define USAGE \
+"usage: limboole [ <option> ... ]\n" \
+"\n" \
+"  -h             print this command line summary and exit\n" \
+"  --version      print the version and exit\n" \
+"  -v             increase verbosity\n" \
+"  -p             pretty print input formula only\n" \
+"  -d             dump generated CNF only\n" \
+"  -c <dag-file>  compile input formula to binary file only\n" \
+"  -s             check satisfiability with SAT Solvers \n "\
+"                       (default is to check validity)\n"\
+"  -o <out-file>  set output file (default <stdout>)\n" \
+"  -l <log-file>  set log file (default <stderr>)\n" \
+"  --batch        solve every formula of the input files on its own,\n" \
+"                 where formulas in one file are separated by lines '%%%%'\n" \
+THREADS_USAGE \
+SERVE_USAGE \
+LINGELING_USAGE \
+PICOSAT_USAGE \
+DEPQBF_USAGE \
+PORTFOLIO_USAGE \
+RACE_USAGE \
+"  <in-file>      input file, text or compiled (default <stdin>)\n"
+
+/*------------------------------------------------------------------------*/
+/* Parse or load the input of 'mgr' and do what the options ask for, which
+ * returns non zero on errors.
+ */
+static int process(Mgr *mgr, int pretty_print) {
+  int error;
+  int res;
+
+  error = 0;
+
+  if (is_dag(mgr)) {
+    if (!load_dag(mgr)) {
+      fprintf(mgr->log, "*** invalid compiled formula '%s'\n",
+              mgr->name ? mgr->name : "<stdin>");
+      error = 1;
+    } else if (mgr->first_prefix && !mgr->use_depqbf) {
+      fprintf(mgr->log,
+              "*** compiled formula has a quantifier prefix (try '-h')\n");
+      error = 1;
+    }
+#ifdef LIMBOOLE_USE_DEPQBF
+    else if (mgr->use_depqbf)
+      declare_prefix(mgr);
+#endif
+  } else {
+    reserve_nodes(mgr, mgr->input_length / 16);
+    if (!parse_parallel(mgr)) {
+      next_token(mgr);
+#ifdef LIMBOOLE_USE_DEPQBF
+      if (mgr->use_depqbf)
+        error = !parse_prefix(mgr);
+#endif
+
+      error = !parse(mgr);
+    }
+  }
+
+  if (!error) {
+    if (mgr->dag) {
+      if (!write_dag(mgr, mgr->dag)) {
+        fprintf(mgr->log, "*** could not write '%s'\n", mgr->dag_name);
+        error = 1;
+      }
+    }
+    else if (pretty_print)
+      pp(mgr);
+    else {
+      if (!mgr->dump || has_cardinality (mgr))
+        normalize (mgr, !mgr->dump);
+      tseitin(mgr);
+      if (!mgr->dump) {
+        res = mgr->result = solve(mgr);
+
+        if (res == 10) {
+          if(mgr->use_depqbf) {
+            fprintf (mgr->out, "%% TRUE FORMULA (satisfying assignment of outermost existential variables follows)\n");
+          } else {
+            if (mgr->check_satisfiability)
+              fprintf(mgr->out, "%% SATISFIABLE formula"
+                                " (satisfying assignment follows)\n");
+            else
+              fprintf(mgr->out, "%% INVALID formula"
+                                " (falsifying assignment follows)\n");
+          }
+
+          print_assignment(mgr);
+        } else if (res == 20) {
+          if(mgr->use_depqbf) {
+fprintf (mgr->out, "%% FALSE formula\n");
+          } else {
+          if (mgr->check_satisfiability)
+            fprintf(mgr->out, "%% UNSATISFIABLE formula\n");
+          else
+            fprintf(mgr->out, "%% VALID formula\n");
+          }
+        } else {
+          fprintf(mgr->out, "%% UNKNOWN result\n");
+        }
+      }
+    }
+  }
+
+  return error;
+}
+
+/*------------------------------------------------------------------------*/
+/* With '--batch' every input holds formulas separated by lines '%%', and
+ * each formula is solved on its own with a fresh manager and solver.  The
+ * results are printed in input order, each after a line '% <name>', where
+ * the name of the input is followed by ':<index>' if it holds several
+ * formulas.  With '-j' several formulas are solved in parallel by worker
+ * threads, which write their results into memory streams.
+ */
+typedef struct Job Job;
+typedef struct Batch Batch;
+
+struct Job
+{
+  const char *name;		/* of the input */
+  unsigned index;		/* of the formula in the input, or zero */
+  unsigned line;		/* of the formula in the input */
+  char *input;
+  size_t input_length;
+  char *output;			/* results written by a worker thread */
+  size_t output_size;
+  int error;
+  int done;
+};
+
+struct Batch
+{
+  Mgr *mgr;			/* with the options */
+  int pretty_print;
+  Job *jobs;
+  unsigned jobs_size;
+  unsigned jobs_count;
+#ifdef LIMBOOLE_USE_THREADS
+  unsigned next;		/* job to be solved next */
+  pthread_mutex_t lock;
+  pthread_cond_t solved;
+#endif
+};
+
+/*------------------------------------------------------------------------*/
+
+static void
+push_job (Batch * batch, const char *name, unsigned index, unsigned line,
+	  char *input, size_t input_length)
+{
+  Job *job;
+
+  if (batch->jobs_size == batch->jobs_count)
+    {
+      batch->jobs_size = batch->jobs_size ? 2 * batch->jobs_size : 16;
+      batch->jobs = (Job *) realloc (batch->jobs,
+				     batch->jobs_size * sizeof (Job));
+    }
+
+  job = batch->jobs + batch->jobs_count++;
+  memset (job, 0, sizeof (*job));
+  job->name = name;
+  job->index = index;
+  job->line = line;
+  job->input = input;
+  job->input_length = input_length;
+}
+
+/*------------------------------------------------------------------------*/
+/* Checks whether a chunk between '%%' lines has only white space and
+ * comments, and thus no formula.
+ */
+static int
+is_blank (const char *p, const char *end)
+{
+  while (p < end)
+    if (*p == '%')
+      {
+	while (p < end && *p != '\n')
+	  p++;
+      }
+    else if (char_class[(unsigned char) *p] & SPACE)
+      p++;
+    else
+      return 0;
+
+  return 1;
+}
+
+/*------------------------------------------------------------------------*/
+/* Compiled formulas are binary and never split.  Blank chunks, such as the
+ * one after a trailing '%%', are skipped, unless the whole input is blank,
+ * which gives the same parse error as without '--batch'.
+ */
+static void
+split_formulas (Batch * batch, Mgr * src, const char *name)
+{
+  char *p, *q, *begin, *end;
+  unsigned first, line, line_begin;
+  size_t len;
+
+  if (is_dag (src))
+    {
+      push_job (batch, name, 0, 0, src->input, src->input_length);
+      return;
+    }
+
+  first = batch->jobs_count;
+  begin = p = src->input;
+  end = src->input + src->input_length;
+  line = line_begin = 0;
+
+  while (p < end)
+    {
+      q = (char *) memchr (p, '\n', (size_t) (end - p));
+      if (!q)
+	q = end;
+      len = (size_t) (q - p);
+      if (len && p[len - 1] == '\r')
+	len--;
+      if (len == 2 && p[0] == '%' && p[1] == '%')
+	{
+	  if (!is_blank (begin, p))
+	    push_job (batch, name, batch->jobs_count - first + 1, line_begin,
+		      begin, (size_t) (p - begin));
+	  begin = q < end ? q + 1 : end;
+	  line_begin = line + 1;
+	}
+      line++;
+      p = q + 1;
+    }
+
+  if (!is_blank (begin, end) || batch->jobs_count == first)
+    push_job (batch, name, batch->jobs_count - first + 1, line_begin,
+	      begin, (size_t) (end - begin));
+
+  if (batch->jobs_count - first == 1)
+    batch->jobs[first].index = 0;
+}
+
+/*------------------------------------------------------------------------*/
+
+static int
+solve_job (Batch * batch, Job * job, FILE * out)
+{
+  Mgr *mgr;
+  int res;
+
+  mgr = init ();
+  mgr->out = out;
+  mgr->log = batch->mgr->log;
+  mgr->name = (char *) job->name;
+  mgr->x = job->line;
+  mgr->input = job->input;
+  mgr->input_length = job->input_length;
+  mgr->check_satisfiability = batch->mgr->check_satisfiability;
+  mgr->use_picosat = batch->mgr->use_picosat;
+  mgr->use_lingeling = batch->mgr->use_lingeling;
+  mgr->use_depqbf = batch->mgr->use_depqbf;
+  mgr->dump = batch->mgr->dump;
+  mgr->qdump = batch->mgr->qdump;
+  mgr->race = batch->mgr->race;
+  mgr->portfolio = batch->mgr->portfolio;
+
+  if (!mgr->dump)
+    connect_solver (mgr);
+  res = process (mgr, batch->pretty_print);
+  release (mgr);
+
+  return res;
 }
 
 /*------------------------------------------------------------------------*/
 
 static void
-add_clause (Mgr * mgr, int * clause)
+print_job_name (Mgr * mgr, Job * job)
+{
+  if (job->index)
+    fprintf (mgr->out, "%% %s:%u\n", job->name, job->index);
+  else
+    fprintf (mgr->out, "%% %s\n", job->name);
+}
+
+/*------------------------------------------------------------------------*/
+#ifdef LIMBOOLE_USE_THREADS
+
+static void *
+batch_worker (void *arg)
 {
-  const int * p;
-  for (p = clause; *p; p++)
+  Batch *batch;
+  unsigned i;
+  FILE *out;
+  Job *job;
+
+  batch = (Batch *) arg;
+  for (;;)
     {
-      add_lit (mgr, *p);
-      if (mgr->dump)
-    fprintf (mgr->out, "%d ", *p);
+      pthread_mutex_lock (&batch->lock);
+      i = batch->next++;
+      pthread_mutex_unlock (&batch->lock);
+      if (i >= batch->jobs_count)
+	break;
+
+      job = batch->jobs + i;
+      if ((out = open_memstream (&job->output, &job->output_size)))
+	{
+	  job->error = solve_job (batch, job, out);
+	  fclose (out);
+	}
+      else
+	job->error = 1;
+
+      pthread_mutex_lock (&batch->lock);
+      job->done = 1;
+      pthread_cond_broadcast (&batch->solved);
+      pthread_mutex_unlock (&batch->lock);
     }
-  add_lit (mgr, 0);
-  if (mgr->dump)
-    fprintf (mgr->out, "0\n");
+
+  return 0;
+}
+
+/*------------------------------------------------------------------------*/
+/* The main thread prints the results of the workers in input order as soon
+ * as they are available.  Returns zero if no worker could be started.
+ */
+static int
+solve_jobs_parallel (Batch * batch)
+{
+  unsigned num_workers, started, i;
+  pthread_t *workers;
+  Mgr *mgr;
+  Job *job;
+
+  mgr = batch->mgr;
+  num_workers = (unsigned) mgr->threads;
+  if (num_workers > batch->jobs_count)
+    num_workers = batch->jobs_count;
+  if (num_workers < 2)
+    return 0;
+
+  pthread_mutex_init (&batch->lock, 0);
+  pthread_cond_init (&batch->solved, 0);
+  batch->next = 0;
+
+  workers = (pthread_t *) malloc (num_workers * sizeof (pthread_t));
+  for (started = 0; started < num_workers; started++)
+    if (pthread_create (workers + started, 0, batch_worker, batch))
+      break;
+
+  if (started)
+    for (i = 0; i < batch->jobs_count; i++)
+      {
+	job = batch->jobs + i;
+	pthread_mutex_lock (&batch->lock);
+	while (!job->done)
+	  pthread_cond_wait (&batch->solved, &batch->lock);
+	pthread_mutex_unlock (&batch->lock);
+
+	print_job_name (mgr, job);
+	if (job->output_size)
+	  fwrite (job->output, 1, job->output_size, mgr->out);
+	free (job->output);
+      }
+
+  for (i = 0; i < started; i++)
+    pthread_join (workers[i], 0);
+  free (workers);
+
+  pthread_cond_destroy (&batch->solved);
+  pthread_mutex_destroy (&batch->lock);
+
+  if (started && mgr->verbose)
+    fprintf (mgr->log, "c solved %u formulas with %u threads\n",
+	     batch->jobs_count, started);
+
+  return started > 0;
+}
+
+#else
+
+static int
+solve_jobs_parallel (Batch * batch)
+{
+  (void) batch;
+  return 0;
 }
 
+#endif
 /*------------------------------------------------------------------------*/
 
-static void
-unit_clause (Mgr * mgr, int a)
+static int
+solve_batch (Mgr * mgr, char **files, unsigned num_files, int pretty_print)
 {
-  int clause[2];
+  unsigned num_srcs, i;
+  Batch batch;
+  Mgr **srcs;
+  int error;
 
-  clause[0] = a;
-  clause[1] = 0;
+  memset (&batch, 0, sizeof (batch));
+  batch.mgr = mgr;
+  batch.pretty_print = pretty_print;
+
+  num_srcs = num_files ? num_files : 1;
+  srcs = (Mgr **) calloc (num_srcs, sizeof (Mgr *));
+  error = 0;
+
+  for (i = 0; !error && i < num_srcs; i++)
+    {
+      srcs[i] = init ();
+      srcs[i]->verbose = mgr->verbose;
+      srcs[i]->log = mgr->log;
+      if (num_files)
+	{
+	  srcs[i]->name = files[i];
+	  if (!(srcs[i]->in = fopen (files[i], "r")))
+	    {
+	      fprintf (mgr->log, "*** could not read '%s'\n", files[i]);
+	      error = 1;
+	      continue;
+	    }
+	  srcs[i]->close_in = 1;
+	}
+      else
+	srcs[i]->name = "<stdin>";
+
+      if (!load_input (srcs[i]))
+	{
+	  fprintf (mgr->log, "*** could not read '%s'\n", srcs[i]->name);
+	  error = 1;
+	}
+      else
+	split_formulas (&batch, srcs[i], srcs[i]->name);
+    }
+
+  if (!error && !solve_jobs_parallel (&batch))
+    for (i = 0; i < batch.jobs_count; i++)
+      {
+	print_job_name (mgr, batch.jobs + i);
+	batch.jobs[i].error = solve_job (&batch, batch.jobs + i, mgr->out);
+      }
 
-  add_clause (mgr, clause);
+  for (i = 0; !error && i < batch.jobs_count; i++)
+    if (batch.jobs[i].error)
+      error = 1;
+
+  for (i = 0; i < num_srcs; i++)
+    if (srcs[i])
+      release (srcs[i]);
+  free (srcs);
+  free (batch.jobs);
+
+  return error;
 }
 
+/*------------------------------------------------------------------------*/
+#ifdef LIMBOOLE_USE_SERVE
+/* With '--serve <path>' limboole answers requests on a Unix socket.  A
+ * request is a line '<id> <op> <limit> <length>' followed by '<length>'
+ * bytes of formula, where '<op>' is as for 'limboole_extended' and a non
+ * zero '<limit>' bounds propagations (PicoSAT) or decisions (DepQBF).  The
+ * line '<id> cancel' cancels a queued or running request.  Every request
+ * is answered once by a line '<id> <status> <length>' followed by
+ * '<length>' bytes of the usual output, where '<status>' is 10 or 20 as
+ * returned by the solver, 0 if the limit was reached or the request was
+ * cancelled, and 1 on errors, with the error messages as output.
+ *
+ * The main thread reads requests into a bounded queue and stops reading
+ * while it is full, which pushes back on the clients.  Worker threads
+ * started up front solve requests.  Answers are appended to the output
+ * buffer of the connection and sent without blocking, and the main thread
+ * sends the rest as soon as the client reads again.  A connection is only
+ * read while its unsent output is small.  After the client shut down
+ * writing, the pending requests are still answered, while requests of
+ * connections which hung up or failed writing are cancelled.
+ */
+#define SERVE_QUEUE 64		/* maximum number of queued requests */
+#define SERVE_HEADER 128	/* maximum length of request lines */
+#define SERVE_LENGTH (1ul << 28)	/* maximum length of formulas */
+#define SERVE_OUTPUT (1 << 20)	/* unsent bytes before reading stops */
+
+typedef struct Connection Connection;
+typedef struct Request Request;
+typedef struct Server Server;
+
+struct Connection
+{
+  int fd;
+  char *buffer;			/* received but not parsed yet */
+  size_t size;
+  size_t count;
+  char *output;			/* answers not sent yet */
+  size_t output_size;
+  size_t output_count;
+  unsigned pending;		/* queued or running requests */
+  int eof;			/* no more requests are read */
+  int closed;			/* hung up or failed writing */
+  pthread_mutex_t write_lock;	/* for the output */
+  Connection *next;
+};
+
+struct Request
+{
+  Connection *connection;
+  unsigned id;
+  int op;
+  unsigned long long limit;
+  char *formula;
+  size_t length;
+  volatile int cancelled;
+  Mgr *mgr;			/* while solving */
+  Request *next;		/* in the queue or the running requests */
+};
+
+struct Server
+{
+  Mgr *mgr;			/* with the options */
+  int fd;			/* listening socket */
+  Connection *connections;
+  Request *first, *last;	/* queue */
+  unsigned queued;
+  Request *running;
+  unsigned requests;		/* answered so far */
+  int stop;
+  pthread_mutex_t lock;
+  pthread_cond_t queue;		/* signalled on new requests and stopping */
+};
+
+static volatile sig_atomic_t serve_signalled;
+static int serve_wakeup[2] = { -1, -1 };	/* pipe waking up 'poll' */
+
 /*------------------------------------------------------------------------*/
 
 static void
-binary_clause (Mgr * mgr, int a, int b)
+wakeup_server (void)
 {
-  int clause[3];
+  char ch = 0;
+  ssize_t bytes;
 
-  clause[0] = a;
-  clause[1] = b;
-  clause[2] = 0;
+  bytes = write (serve_wakeup[1], &ch, 1);
+  (void) bytes;
+}
 
-  add_clause (mgr, clause);
+/*------------------------------------------------------------------------*/
+
+static void
+catch_serve_signal (int sig)
+{
+  (void) sig;
+  serve_signalled = 1;
+  wakeup_server ();
 }
 
 /*------------------------------------------------------------------------*/
 
 static void
-ternary_clause (Mgr * mgr, int a, int b, int c)
+append_output (Connection * connection, const char *data, size_t size)
 {
-  int clause[4];
+  while (connection->output_size - connection->output_count < size)
+    {
+      connection->output_size =
+	connection->output_size ? 2 * connection->output_size : 1 << 12;
+      connection->output = (char *) realloc (connection->output,
+					     connection->output_size);
+    }
 
-  clause[0] = a;
-  clause[1] = b;
-  clause[2] = c;
-  clause[3] = 0;
+  memcpy (connection->output + connection->output_count, data, size);
+  connection->output_count += size;
+}
+
+/*------------------------------------------------------------------------*/
+/* Sends as much output of 'connection' as the socket takes without
+ * blocking.  Needs the write lock and returns zero if sending failed.
+ */
+static int
+flush_output (Connection * connection)
+{
+  ssize_t bytes;
+
+  while (connection->output_count)
+    {
+      bytes = send (connection->fd, connection->output,
+		    connection->output_count, MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (bytes < 0 && errno == EINTR)
+	continue;
+      if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	break;
+      if (bytes <= 0)
+	return 0;
+      connection->output_count -= (size_t) bytes;
+      memmove (connection->output, connection->output + bytes,
+	       connection->output_count);
+    }
 
-  add_clause (mgr, clause);
+  return 1;
 }
 
 /*------------------------------------------------------------------------*/
 
+static unsigned cancel_requests (Server *, Connection *, int, unsigned);
+
 static void
-tseitin (Mgr * mgr)
+close_connection (Server * server, Connection * connection)
 {
-  int num_clauses;
-  int sign;
-  Node *p;
+  pthread_mutex_lock (&server->lock);
+  connection->closed = 1;
+  cancel_requests (server, connection, 1, 0);
+  pthread_mutex_unlock (&server->lock);
+}
 
-  num_clauses = 0;
+/*------------------------------------------------------------------------*/
+/* Never blocks, and wakes up the main thread to send what is left.
+ * Returns zero and closes 'connection' if sending failed.
+ */
+static int
+answer (Server * server, Connection * connection, unsigned id, int status,
+	const char *output, size_t size)
+{
+  size_t remaining;
+  char header[64];
+  int len, res;
+
+  len = sprintf (header, "%u %d %lu\n", id, status, (unsigned long) size);
+
+  pthread_mutex_lock (&connection->write_lock);
+  append_output (connection, header, (size_t) len);
+  if (size)
+    append_output (connection, output, size);
+  res = flush_output (connection);
+  remaining = connection->output_count;
+  pthread_mutex_unlock (&connection->write_lock);
+
+  if (!res)
+    close_connection (server, connection);
+  else if (remaining)
+    wakeup_server ();
 
-  for (p = mgr->first; p; p = p->next_inserted) {
-    if (!p->idx) {
-      p->idx = ++mgr->idx;
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+/* Solve one request with a fresh manager like a single formula on the
+ * command line, with errors written to the output as well.
+ */
+static int
+solve_request (Server * server, Request * request, char **output,
+	       size_t * size)
+{
+  FILE *out;
+  Mgr *mgr;
+  int res;
+
+  *output = 0;
+  *size = 0;
+  if (!(out = open_memstream (output, size)))
+    return 1;
 
+  res = 1;
+  if (request->op < 0 || request->op > 3)
+    fprintf (out, "*** invalid op code %d\n", request->op);
+#ifndef LIMBOOLE_USE_DEPQBF
+  else if (request->op > 1)
+    fprintf (out, "*** no support for DepQBF compiled in\n");
+#endif
+  else
+    {
+      mgr = init ();
+      mgr->out = out;
+      mgr->log = out;
+      mgr->name = "<request>";
+      mgr->input = request->formula;
+      mgr->input_length = request->length;
+      mgr->check_satisfiability = request->op & 1;
 #ifdef LIMBOOLE_USE_DEPQBF
-      if(mgr->use_depqbf) {
-        if (p->type == VAR) {
-          qdpll_add_var_to_scope(mgr->qdpll, p->idx, mgr->outer);
-          mgr->free_vars = 1;
-        } else {
-          qdpll_add_var_to_scope(mgr->qdpll, p->idx, mgr->inner);
-        }
-      }
+      mgr->use_depqbf = request->op > 1;
+#endif
+#if defined(LIMBOOLE_USE_PICOSAT)
+      mgr->use_picosat = request->op < 2;
+#elif defined(LIMBOOLE_USE_LINGELING)
+      mgr->use_lingeling = request->op < 2;
 #endif
-      if (mgr->dump && p->type == VAR)
-        fprintf(mgr->out, "c %d %s\n", p->idx, p->data.as_name);
+      mgr->limit = request->limit;
+      mgr->cancel = &request->cancelled;
+      mgr->cancel_lock = &server->lock;
+
+      connect_solver (mgr);
+      pthread_mutex_lock (&server->lock);
+      request->mgr = mgr;
+      pthread_mutex_unlock (&server->lock);
+
+      res = process (mgr, 0) ? 1 : mgr->result;
+
+      pthread_mutex_lock (&server->lock);
+      request->mgr = 0;
+      pthread_mutex_unlock (&server->lock);
+      release (mgr);
     }
 
-    switch (p->type) {
-    case IFF:
-      num_clauses += 4;
-      break;
-    case OR:
-    case AND:
-    case IMPLIES:
-    case SEILPMI:
-      num_clauses += 3;
-      break;
-    case NOT:
-      num_clauses += 2;
-      break;
-    default:
-      assert (p->type == VAR);
-      break;
+  fclose (out);
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void *
+serve_worker (void *arg)
+{
+  Connection *connection;
+  Request *request, **p;
+  Server *server;
+  char *output;
+  size_t size;
+  int status;
+  int closed;
+
+  server = (Server *) arg;
+  pthread_mutex_lock (&server->lock);
+
+  for (;;)
+    {
+      while (!server->first && !server->stop)
+	pthread_cond_wait (&server->queue, &server->lock);
+      if (server->stop)
+	break;
+
+      request = server->first;
+      if (!(server->first = request->next))
+	server->last = 0;
+      if (server->queued-- == SERVE_QUEUE)
+	wakeup_server ();	/* to read requests again */
+      request->next = server->running;
+      server->running = request;
+      pthread_mutex_unlock (&server->lock);
+
+      status = solve_request (server, request, &output, &size);
+
+      pthread_mutex_lock (&server->lock);
+      for (p = &server->running; *p != request; p = &(*p)->next)
+	;
+      *p = request->next;
+      connection = request->connection;
+      closed = connection->closed;
+      pthread_mutex_unlock (&server->lock);
+
+      if (!closed)
+	answer (server, connection, request->id, status, output, size);
+      free (output);
+
+      pthread_mutex_lock (&server->lock);
+      server->requests++;
+      if (!--connection->pending && (connection->closed || connection->eof))
+	wakeup_server ();	/* to release the connection */
+      free (request->formula);
+      free (request);
     }
-  }
 
-  mgr->idx2node = (Node **) calloc (mgr->idx + 1, sizeof (Node *));
-  for (p = mgr->first; p; p = p->next_inserted)
-    mgr->idx2node[p->idx] = p;
+  pthread_mutex_unlock (&server->lock);
 
-  if (mgr->dump)
-    fprintf (mgr->out, "p cnf %d %u\n", mgr->idx, num_clauses + 1);
+  return 0;
+}
+
+/*------------------------------------------------------------------------*/
+/* Removes queued requests and flags running ones as cancelled, either all
+ * of 'connection' or only those with 'id' if 'all' is zero.  Needs the
+ * lock of the server and returns the number of removed requests.
+ */
+static unsigned
+cancel_requests (Server * server, Connection * connection, int all,
+		 unsigned id)
+{
+  Request *request, **p;
+  unsigned res;
+
+  res = 0;
+  for (request = server->running; request; request = request->next)
+    if (request->connection == connection && (all || request->id == id))
+      {
+	request->cancelled = 1;
+#ifdef LIMBOOLE_USE_PICOSAT
+	if (request->mgr && request->mgr->picosat)
+	  cancel_picosat (request->mgr->picosat, request->mgr->solving);
+#endif
+      }
 
-  for (p = mgr->first; p; p = p->next_inserted)
+  p = &server->first;
+  server->last = 0;
+  while ((request = *p))
     {
-      switch (p->type)
+      if (request->connection == connection && (all || request->id == id))
 	{
-	case IFF:
-	  ternary_clause (mgr, p->idx,
-			  -p->data.as_child[0]->idx,
-			  -p->data.as_child[1]->idx);
-	  ternary_clause (mgr, p->idx, p->data.as_child[0]->idx,
-			  p->data.as_child[1]->idx);
-	  ternary_clause (mgr, -p->idx, -p->data.as_child[0]->idx,
-			  p->data.as_child[1]->idx);
-	  ternary_clause (mgr, -p->idx, p->data.as_child[0]->idx,
-			  -p->data.as_child[1]->idx);
-	  break;
-	case IMPLIES:
-	  binary_clause (mgr, p->idx, p->data.as_child[0]->idx);
-	  binary_clause (mgr, p->idx, -p->data.as_child[1]->idx);
-	  ternary_clause (mgr, -p->idx,
-			  -p->data.as_child[0]->idx,
-			  p->data.as_child[1]->idx);
-	  break;
-	case SEILPMI:
-	  binary_clause (mgr, p->idx, -p->data.as_child[0]->idx);
-	  binary_clause (mgr, p->idx, p->data.as_child[1]->idx);
-	  ternary_clause (mgr, -p->idx,
-			  p->data.as_child[0]->idx,
-			  -p->data.as_child[1]->idx);
-	  break;
-	case OR:
-	  binary_clause (mgr, p->idx, -p->data.as_child[0]->idx);
-	  binary_clause (mgr, p->idx, -p->data.as_child[1]->idx);
-	  ternary_clause (mgr, -p->idx,
-			  p->data.as_child[0]->idx, p->data.as_child[1]->idx);
-	  break;
-	case AND:
-	  binary_clause (mgr, -p->idx, p->data.as_child[0]->idx);
-	  binary_clause (mgr, -p->idx, p->data.as_child[1]->idx);
-	  ternary_clause (mgr, p->idx,
-			  -p->data.as_child[0]->idx,
-			  -p->data.as_child[1]->idx);
-	  break;
-	case NOT:
-	  binary_clause (mgr, p->idx, p->data.as_child[0]->idx);
-	  binary_clause (mgr, -p->idx, -p->data.as_child[0]->idx);
-	  break;
-	default:
-	  assert (p->type == VAR);
-	  break;
+	  *p = request->next;
+	  if (server->queued-- == SERVE_QUEUE)
+	    wakeup_server ();
+	  connection->pending--;
+	  res++;
+	  free (request->formula);
+	  free (request);
+	}
+      else
+	{
+	  server->last = request;
+	  p = &request->next;
 	}
     }
 
-  assert (mgr->root);
-
-  sign = (mgr->check_satisfiability) ? 1 : -1;
-  if(mgr->use_depqbf) sign = 1;
-  unit_clause (mgr, sign * mgr->root->idx);
+  return res;
 }
 
 /*------------------------------------------------------------------------*/
-
-static void
-pp_aux (Mgr * mgr, Node * node, Type outer)
+/* Queues the complete requests in the buffer of 'connection' as long as
+ * the queue has room.  Returns zero on protocol errors, which includes an
+ * incomplete request after the end of the input.
+ */
+static int
+parse_requests (Server * server, Connection * connection)
 {
-  int le, lt;
+  unsigned long long limit;
+  unsigned long length;
+  char line[SERVE_HEADER + 1], word[16], ch;
+  unsigned id, removed;
+  Request *request;
+  size_t pos, len;
+  int op, full;
+  char *eol;
+
+  pos = 0;
+  while (pos < connection->count)
+    {
+      pthread_mutex_lock (&server->lock);
+      full = server->queued >= SERVE_QUEUE;
+      pthread_mutex_unlock (&server->lock);
+      if (full)
+	break;
+
+      eol = (char *) memchr (connection->buffer + pos, '\n',
+			     connection->count - pos);
+      if (!eol)
+	{
+	  if (connection->count - pos > SERVE_HEADER || connection->eof)
+	    return 0;
+	  break;
+	}
 
-  le = outer <= node->type;
-  lt = outer < node->type;
+      len = (size_t) (eol - (connection->buffer + pos));
+      if (len > SERVE_HEADER)
+	return 0;
+      memcpy (line, connection->buffer + pos, len);
+      line[len] = 0;
 
-  switch (node->type)
-    {
-    case NOT:
-      fputc ('!', mgr->out);
-      pp_aux (mgr, node->data.as_child[0], node->type);
-      break;
-    case IMPLIES:
-    case SEILPMI:
-      if (le)
-	fputc ('(', mgr->out);
-      pp_aux (mgr, node->data.as_child[0], node->type);
-      fputs (node->type == IMPLIES ? " -> " : " <- ", mgr->out);
-      pp_aux (mgr, node->data.as_child[1], node->type);
-      if (le)
-	fputc (')', mgr->out);
-      break;
+      if (sscanf (line, "%u %15s %c", &id, word, &ch) == 2
+	  && !strcmp (word, "cancel"))
+	{
+	  pthread_mutex_lock (&server->lock);
+	  removed = cancel_requests (server, connection, 0, id);
+	  pthread_mutex_unlock (&server->lock);
+	  pos += len + 1;
+	  while (removed--)
+	    if (!answer (server, connection, id, 0, 0, 0))
+	      return 1;
+	  continue;
+	}
 
-    case OR:
-    case AND:
-    case IFF:
-      if (lt)
-	fputc ('(', mgr->out);
-      pp_aux (mgr, node->data.as_child[0], node->type);
-      if (node->type == OR)
-	fputs (" | ", mgr->out);
-      else if (node->type == AND)
-	fputs (" & ", mgr->out);
+      if (sscanf (line, "%u %d %llu %lu %c", &id, &op, &limit, &length,
+		  &ch) != 4 || length > SERVE_LENGTH)
+	return 0;
+
+      if (connection->count - pos - len - 1 < length)
+	{
+	  if (connection->eof)
+	    return 0;
+	  break;		/* formula not complete yet */
+	}
+
+      pos += len + 1;
+      request = (Request *) malloc (sizeof (*request));
+      memset (request, 0, sizeof (*request));
+      request->connection = connection;
+      request->id = id;
+      request->op = op;
+      request->limit = limit;
+      request->length = length;
+      request->formula = (char *) malloc (length ? length : 1);
+      memcpy (request->formula, connection->buffer + pos, length);
+      pos += length;
+
+      pthread_mutex_lock (&server->lock);
+      if (server->last)
+	server->last->next = request;
       else
-	fputs (" <-> ", mgr->out);
-      pp_aux (mgr, node->data.as_child[1], node->type);
-      if (lt)
-	fputc (')', mgr->out);
-      break;
+	server->first = request;
+      server->last = request;
+      server->queued++;
+      connection->pending++;
+      pthread_cond_signal (&server->queue);
+      pthread_mutex_unlock (&server->lock);
+    }
 
-    default:
-      assert (node->type == VAR);
-      fprintf (mgr->out, "%s", node->data.as_name);
-      break;
+  if (pos)
+    {
+      connection->count -= pos;
+      memmove (connection->buffer, connection->buffer + pos,
+	       connection->count);
     }
+
+  return 1;
 }
 
-/*------------------------------------------------------------------------*/
+/*------------------------------------------------------------------------*/
+
+static void
+read_requests (Server * server, Connection * connection)
+{
+  ssize_t bytes;
+
+  if (connection->size - connection->count < (1 << 12))
+    {
+      connection->size = connection->size ? 2 * connection->size : 1 << 16;
+      connection->buffer = (char *) realloc (connection->buffer,
+					     connection->size);
+    }
+
+  bytes = read (connection->fd, connection->buffer + connection->count,
+		connection->size - connection->count);
+  if (bytes < 0 && (errno == EINTR || errno == EAGAIN
+		    || errno == EWOULDBLOCK))
+    return;
 
-static void
-pp_and (Mgr * mgr, Node * node)
-{
-  if (node->type == AND)
+  if (bytes < 0)
+    close_connection (server, connection);
+  else if (!bytes)
     {
-      pp_and (mgr, node->data.as_child[0]);
-      fprintf (mgr->out, "\n&\n");
-      pp_and (mgr, node->data.as_child[1]);
+      pthread_mutex_lock (&server->lock);
+      connection->eof = 1;	/* but answers are still sent */
+      pthread_mutex_unlock (&server->lock);
     }
   else
-    pp_aux (mgr, node, AND);
+    connection->count += (size_t) bytes;
 }
 
 /*------------------------------------------------------------------------*/
 
-static void
-pp_or (Mgr * mgr, Node * node)
+static Connection *
+accept_connection (Server * server)
 {
-  if (node->type == OR)
+  Connection *res;
+  int fd;
+
+  if ((fd = accept (server->fd, 0, 0)) < 0)
+    return 0;
+
+  if (fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK))
     {
-      pp_or (mgr, node->data.as_child[0]);
-      fprintf (mgr->out, "\n|\n");
-      pp_or (mgr, node->data.as_child[1]);
+      close (fd);
+      return 0;
     }
-  else
-    pp_aux (mgr, node, OR);
+
+  res = (Connection *) malloc (sizeof (*res));
+  memset (res, 0, sizeof (*res));
+  res->fd = fd;
+  pthread_mutex_init (&res->write_lock, 0);
+  res->next = server->connections;
+  server->connections = res;
+
+  return res;
 }
 
 /*------------------------------------------------------------------------*/
-
+/* Connections are released by the main thread as soon as no worker holds
+ * one of their requests anymore and they are closed, or all answers are
+ * sent after the end of their input.
+ */
 static void
-pp_and_or (Mgr * mgr, Node * node, Type outer)
+release_connections (Server * server, int all)
 {
-  assert (outer > AND);
-  assert (outer > OR);
+  Connection *connection, **p;
+  int release, closed;
 
-  if (node->type == AND)
-    pp_and (mgr, node);
-  else if (node->type == OR)
-    pp_or (mgr, node);
-  else
-    pp_aux (mgr, node, outer);
+  p = &server->connections;
+  while ((connection = *p))
+    {
+      pthread_mutex_lock (&server->lock);
+      closed = connection->closed;
+      release = !connection->pending && (closed || connection->eof);
+      pthread_mutex_unlock (&server->lock);
+
+      if (release && !closed)
+	{
+	  pthread_mutex_lock (&connection->write_lock);
+	  release = !connection->output_count;
+	  pthread_mutex_unlock (&connection->write_lock);
+	}
+      release |= all;
+
+      if (release)
+	{
+	  *p = connection->next;
+	  close (connection->fd);
+	  pthread_mutex_destroy (&connection->write_lock);
+	  free (connection->output);
+	  free (connection->buffer);
+	  free (connection);
+	}
+      else
+	p = &connection->next;
+    }
 }
 
 /*------------------------------------------------------------------------*/
 
-static void
-pp_iff_implies (Mgr * mgr, Node * node, Type outer)
+static int
+open_socket (Mgr * mgr, const char *path)
 {
-  if (node->type == IFF || node->type == IMPLIES)
+  int fd, probe, listening, refused;
+  struct sockaddr_un addr;
+  struct stat st;
+
+  if (strlen (path) >= sizeof (addr.sun_path))
     {
-      pp_and_or (mgr, node->data.as_child[0], node->type);
-      fprintf (mgr->out, "\n%s\n", node->type == IFF ? "<->" : "->");
-      pp_and_or (mgr, node->data.as_child[1], node->type);
+      fprintf (mgr->log, "*** socket path '%s' too long\n", path);
+      return -1;
     }
-  else
-    pp_and_or (mgr, node, outer);
-}
 
-/*------------------------------------------------------------------------*/
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
 
-static void pp_prefix(Mgr *mgr) {
-  PNode *n;
+  /* Remove a stale socket of a previous server but nothing else.  A socket
+   * is only stale if connecting is refused, since otherwise another server
+   * still listens on it.
+   */
+  if (!lstat (path, &st) && S_ISSOCK (st.st_mode))
+    {
+      probe = socket (AF_UNIX, SOCK_STREAM, 0);
+      listening = probe >= 0
+	&& !connect (probe, (struct sockaddr *) &addr, sizeof (addr));
+      refused = !listening && errno == ECONNREFUSED;
+      if (probe >= 0)
+	close (probe);
+
+      if (listening)
+	{
+	  fprintf (mgr->log, "*** another server listens on '%s'\n", path);
+	  return -1;
+	}
+      if (refused)
+	unlink (path);
+    }
 
-  for (n = mgr->first_prefix; n; n = n->next) {
-    if (n->type == ALL)
-      fprintf(mgr->out, "#");
-    else
-      fprintf(mgr->out, "?");
+  if ((fd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0)
+    {
+      fprintf (mgr->log, "*** could not create socket\n");
+      return -1;
+    }
 
-    printf("%s ", n->node->data.as_name);
-  }
+  if (bind (fd, (struct sockaddr *) &addr, sizeof (addr))
+      || listen (fd, SOMAXCONN))
+    {
+      fprintf (mgr->log, "*** could not listen on '%s'\n", path);
+      close (fd);
+      return -1;
+    }
+
+  return fd;
 }
 
 /*------------------------------------------------------------------------*/
-
-static void
-pp (Mgr * mgr)
+/* Runs until SIGINT or SIGTERM.
+ */
+static int
+serve (Mgr * mgr, const char *path)
 {
-  assert (mgr->root);
-  pp_prefix (mgr);
-  pp_iff_implies (mgr, mgr->root, DONE);
-  fputc ('\n', mgr->out);
-}
+  struct sigaction action, old_int, old_term;
+  unsigned num_workers, started, num_fds, i;
+  Connection *connection, **polled;
+  int closed, eof, output;
+  size_t unsent;
+  sigset_t all, old_mask;
+  struct pollfd *fds;
+  pthread_t *workers;
+  Request *request;
+  Server server;
+  char drain[64];
+  int full;
+
+  memset (&server, 0, sizeof (server));
+  server.mgr = mgr;
+  if ((server.fd = open_socket (mgr, path)) < 0)
+    return 1;
 
-/*------------------------------------------------------------------------*/
+  if (pipe (serve_wakeup)
+      || fcntl (serve_wakeup[0], F_SETFL, O_NONBLOCK)
+      || fcntl (serve_wakeup[1], F_SETFL, O_NONBLOCK))
+    {
+      if (serve_wakeup[0] >= 0)
+	{
+	  close (serve_wakeup[0]);
+	  close (serve_wakeup[1]);
+	  serve_wakeup[0] = serve_wakeup[1] = -1;
+	}
+      fprintf (mgr->log, "*** could not create pipe\n");
+      close (server.fd);
+      unlink (path);
+      return 1;
+    }
 
-static void
-print_assignment (Mgr * mgr)
-{
-  int idx, val;
-  Node * n;
-  for (idx = 1; idx <= mgr->idx; idx++)
+  pthread_mutex_init (&server.lock, 0);
+  pthread_cond_init (&server.queue, 0);
+
+  /* Only the main thread handles signals.
+   */
+  serve_signalled = 0;
+  memset (&action, 0, sizeof (action));
+  action.sa_handler = catch_serve_signal;
+  sigemptyset (&action.sa_mask);
+  sigaction (SIGINT, &action, &old_int);
+  sigaction (SIGTERM, &action, &old_term);
+
+  sigfillset (&all);
+  pthread_sigmask (SIG_SETMASK, &all, &old_mask);
+  num_workers = mgr->threads > 0 ? (unsigned) mgr->threads : 1;
+  workers = (pthread_t *) malloc (num_workers * sizeof (pthread_t));
+  for (started = 0; started < num_workers; started++)
+    if (pthread_create (workers + started, 0, serve_worker, &server))
+      break;
+  pthread_sigmask (SIG_SETMASK, &old_mask, 0);
+
+  if (mgr->verbose)
+    fprintf (mgr->log, "c serving on '%s' with %u workers\n", path, started);
+  fflush (mgr->log);
+
+  fds = 0;
+  polled = 0;
+
+  while (started && !serve_signalled)
     {
-      val = 0;
-#ifdef LIMBOOLE_USE_PICOSAT
-      if (mgr->picosat)
-    val = picosat_deref (mgr->picosat, idx);
-#endif
-#ifdef LIMBOOLE_USE_LINGELING
-      if (mgr->lgl)
-    val = lglderef (mgr->lgl, idx);
-#endif
-#ifdef LIMBOOLE_USE_DEPQBF
-      if (mgr->qdpll) {
-        if (qdpll_get_nesting_of_var(mgr->qdpll, idx) == mgr->outer) {
-          val = qdpll_get_value(mgr->qdpll, idx);
-        } else {
-          val = 0;
-        }
-      }
-#endif
-      n = mgr->idx2node[idx];
-      if ((n->type == VAR) && (!mgr->qdpll || (mgr->qdpll && val != 0)))
-        fprintf(mgr->out, "%s = %d\n", n->data.as_name, val > 0);
-  }
-}
+      pthread_mutex_lock (&server.lock);
+      full = server.queued >= SERVE_QUEUE;
+      pthread_mutex_unlock (&server.lock);
+
+      num_fds = 2;
+      for (connection = server.connections; connection;
+	   connection = connection->next)
+	num_fds++;
+
+      fds = (struct pollfd *) realloc (fds, num_fds * sizeof (*fds));
+      polled = (Connection **) realloc (polled, num_fds * sizeof (*polled));
+      memset (fds, 0, num_fds * sizeof (*fds));
+
+      fds[0].fd = serve_wakeup[0];
+      fds[0].events = POLLIN;
+      fds[1].fd = server.fd;
+      fds[1].events = POLLIN;
+
+      /* Connections which are not read are still polled for hang ups,
+       * which are reported even without asking for them.
+       */
+      for (i = 2, connection = server.connections; connection;
+	   connection = connection->next, i++)
+	{
+	  pthread_mutex_lock (&server.lock);
+	  closed = connection->closed;
+	  eof = connection->eof;
+	  pthread_mutex_unlock (&server.lock);
+	  pthread_mutex_lock (&connection->write_lock);
+	  unsent = connection->output_count;
+	  pthread_mutex_unlock (&connection->write_lock);
+
+	  polled[i] = connection;
+	  fds[i].fd = closed ? -1 : connection->fd;
+	  if (!full && !eof && unsent < SERVE_OUTPUT)
+	    fds[i].events |= POLLIN;
+	  if (unsent)
+	    fds[i].events |= POLLOUT;
+	}
 
-/*------------------------------------------------------------------------*/
-#if defined(LIMBOOLE_USE_PICOSAT) && defined(LIMBOOLE_USE_LINGELING) && defined(LIMBOOLE_USE_DEPQBF)
-#define PICOSAT_USAGE \
-"  --picosat      use PicoSAT as SAT solver back-end (disabled by default)\n"
-#define LINGELING_USAGE \
-"  --lingeling    use Lingeling as SAT solver back-end (default)\n"
-#define DEPQBF_USAGE \
-"  --depqbf       use DepQBF as QBF solver back-end (disabled by default)\n"
-#endif
+      if (poll (fds, num_fds, -1) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  fprintf (mgr->log, "*** polling failed\n");
+	  break;
+	}
 
-#if defined(LIMBOOLE_USE_PICOSAT) && defined(LIMBOOLE_USE_LINGELING) && !defined(LIMBOOLE_USE_DEPQBF)
-#define PICOSAT_USAGE \
-"  --picosat      use PicoSAT as SAT solver back-end (disabled by default)\n"
-#define LINGELING_USAGE \
-"  --lingeling    use Lingeling as SAT solver back-end (default)\n"
-#define DEPQBF_USAGE \
-"  --depqbf       no support for DepQBF compiled in\n"
-#endif
+      if (fds[0].revents)
+	while (read (serve_wakeup[0], drain, sizeof (drain)) > 0)
+	  ;
 
-#if !defined(LIMBOOLE_USE_PICOSAT) && defined(LIMBOOLE_USE_LINGELING) && defined(LIMBOOLE_USE_DEPQBF)
-#define PICOSAT_USAGE \
-"  --picosat      no support for PicoSAT SAT solver compiled in\n"
-#define LINGELING_USAGE \
-"  --lingeling    using Lingeling (as the only available SAT solver back-end)\n"
-#define DEPQBF_USAGE \
-"  --depqbf       use DepQBF as QBF solver back-end \n"
-#endif
+      for (i = 2; i < num_fds; i++)
+	{
+	  if (fds[i].fd < 0 || !fds[i].revents)
+	    continue;
+	  connection = polled[i];
+	  if (fds[i].revents & (POLLHUP | POLLERR | POLLNVAL))
+	    {
+	      close_connection (&server, connection);
+	      continue;
+	    }
+	  if (fds[i].revents & POLLOUT)
+	    {
+	      pthread_mutex_lock (&connection->write_lock);
+	      output = flush_output (connection);
+	      pthread_mutex_unlock (&connection->write_lock);
+	      if (!output)
+		{
+		  close_connection (&server, connection);
+		  continue;
+		}
+	    }
+	  if (fds[i].revents & POLLIN)
+	    read_requests (&server, connection);
+	}
 
-#if !defined(LIMBOOLE_USE_PICOSAT) && defined(LIMBOOLE_USE_LINGELING) && !defined(LIMBOOLE_USE_DEPQBF)
-#define PICOSAT_USAGE \
-"  --picosat      no support for PicoSAT SAT solver compiled in\n"
-#define LINGELING_USAGE \
-"  --lingeling    using Lingeling (as the only available SAT solver back-end)\n"
-#define DEPQBF_USAGE \
-"  --depqbf       no support for DepQBF built in \n"
-#endif
+      if (fds[1].revents & POLLIN)
+	accept_connection (&server);
 
-#if defined(LIMBOOLE_USE_PICOSAT) && !defined(LIMBOOLE_USE_LINGELING) && defined(LIMBOOLE_USE_DEPQBF)
-#define PICOSAT_USAGE \
-"  --picosat      using PicoSAT \n"
-#define LINGELING_USAGE \
-"  --lingeling    no support for Lingeling SAT solver compiled in\n"
-#define DEPQBF_USAGE \
-"  --depqbf       use DepQBF as QBF solver back-end\n"
-#endif
+      for (connection = server.connections; connection;
+	   connection = connection->next)
+	{
+	  pthread_mutex_lock (&server.lock);
+	  closed = connection->closed;
+	  pthread_mutex_unlock (&server.lock);
+	  if (closed || parse_requests (&server, connection))
+	    continue;
+
+	  /* Answer the pending requests before closing.
+	   */
+	  answer (&server, connection, 0, 1, "*** protocol error\n", 19);
+	  pthread_mutex_lock (&server.lock);
+	  connection->eof = 1;
+	  pthread_mutex_unlock (&server.lock);
+	  connection->count = 0;
+	}
 
-#if defined(LIMBOOLE_USE_PICOSAT) && !defined(LIMBOOLE_USE_LINGELING) && !defined(LIMBOOLE_USE_DEPQBF)
-#define PICOSAT_USAGE \
-"  --picosat      using PicoSAT (as the only available SAT solver back-end)\n"
-#define LINGELING_USAGE \
-"  --lingeling    no support for Lingeling SAT solver compiled in\n"
-#define DEPQBF_USAGE \
-"  --depqbf       no support for DepQBF compiled in\n"
-#endif
+      release_connections (&server, 0);
+    }
 
-#if !defined(LIMBOOLE_USE_PICOSAT) && !defined(LIMBOOLE_USE_LINGELING) && defined(LIMBOOLE_USE_DEPQBF)
-#define PICOSAT_USAGE \
-"  --picosat      no support for PicoSAT SAT solver compiled in\n"
-#define LINGELING_USAGE \
-"  --lingeling    no support for Lingeling SAT solver compiled in\n"
-#define DEPQBF_USAGE \
-"  --depqbf       using DepQBF as QBF solver back-end\n"
+  pthread_mutex_lock (&server.lock);
+  server.stop = 1;
+  for (request = server.running; request; request = request->next)
+    {
+      request->cancelled = 1;
+#ifdef LIMBOOLE_USE_PICOSAT
+      if (request->mgr && request->mgr->picosat)
+	cancel_picosat (request->mgr->picosat, request->mgr->solving);
 #endif
+    }
+  pthread_cond_broadcast (&server.queue);
+  pthread_mutex_unlock (&server.lock);
 
-#if !defined(LIMBOOLE_USE_PICOSAT) && !defined(LIMBOOLE_USE_LINGELING) \
-  && !defined(LIMBOOLE_USE_DEPQBF)
-#error "At least one of Lingeling or PicoSAT or DepQBF has to be available!"
-#endif
+  for (i = 0; i < started; i++)
+    pthread_join (workers[i], 0);
+  free (workers);
 
+  while ((request = server.first))
+    {
+      server.first = request->next;
+      free (request->formula);
+      free (request);
+    }
 
+  if (mgr->verbose)
+    fprintf (mgr->log, "c answered %u requests\n", server.requests);
 
-#define USAGE \
-"usage: limboole [ <option> ... ]\n" \
-"\n" \
-"  -h             print this command line summary and exit\n" \
-"  --version      print the version and exit\n" \
-"  -v             increase verbosity\n" \
-"  -p             pretty print input formula only\n" \
-"  -d             dump generated CNF only\n" \
-"  -s             check satisfiability with SAT Solvers \n "\
-"                       (default is to check validity)\n"\
-"  -o <out-file>  set output file (default <stdout>)\n" \
-"  -l <log-file>  set log file (default <stderr>)\n" \
-LINGELING_USAGE \
-PICOSAT_USAGE \
-DEPQBF_USAGE \
-"  <in-file>      input file (default <stdin>)\n"
+  release_connections (&server, 1);
+  free (fds);
+  free (polled);
 
-/*------------------------------------------------------------------------*/
+  sigaction (SIGINT, &old_int, 0);
+  sigaction (SIGTERM, &old_term, 0);
+
+  close (serve_wakeup[0]);
+  close (serve_wakeup[1]);
+  serve_wakeup[0] = serve_wakeup[1] = -1;
+  pthread_cond_destroy (&server.queue);
+  pthread_mutex_destroy (&server.lock);
+  close (server.fd);
+  unlink (path);
 
+  return !started;
+}
+
+#endif
+/*------------------------------------------------------------------------*/
 
 int limboole_extended(int argc, char **argv, int op, char *input,
              unsigned int input_length) {
   const int *assignment;
+  const char *serve_path;
+  unsigned num_files;
   int pretty_print;
+  int solver_option;
+  char **files;
   FILE *file;
+  int batch;
   int error;
   Mgr *mgr;
   int done;
-  int res;
   int i;
 
   done = 0;
   error = 0;
   pretty_print = 0;
+  solver_option = 0;
 
   mgr = init();
 
+  /* In batch mode file arguments are collected instead of opened.
+   */
+  batch = 0;
+  for (i = 1; i < argc; i++)
+    if (!strcmp(argv[i], "--batch"))
+      batch = 1;
+  files = batch ? (char **) malloc(argc * sizeof (char *)) : 0;
+  num_files = 0;
+  serve_path = 0;
+
   mgr->input = input;
   mgr->input_length = input_length;
 
@@ -1456,15 +7247,34 @@ int limboole_extended(int argc, char **argv, int op, char *input,
     } else if (!strcmp(argv[i], "-p")) {
       pretty_print = 1;
     } else if (!strcmp(argv[i], "-d")) {
-      if (mgr->use_depqbf) {
-        mgr->dump = 0;
-        mgr->qdump = 1;
-      } else {
-        mgr->dump = 1;
-        mgr->qdump = 0;
-      }
+      mgr->dump = 1;
     } else if (!strcmp(argv[i], "-s")) {
       mgr->check_satisfiability = 1;
+    } else if (!strcmp(argv[i], "-c")) {
+      if (i == argc - 1) {
+        fprintf(mgr->log, "*** argument to '-c' missing (try '-h')\n");
+        error = 1;
+      } else if (batch) {
+        fprintf(mgr->log, "*** can not combine '-c' and '--batch'\n");
+        error = 1;
+      } else if (mgr->dag) {
+        fprintf(mgr->log, "*** '-c' specified twice (try '-h')\n");
+        error = 1;
+      } else if (!(mgr->dag = fopen(argv[++i], "wb"))) {
+        fprintf(mgr->log, "*** could not write '%s'\n", argv[i]);
+        error = 1;
+      } else {
+        mgr->dag_name = argv[i];
+      }
+    } else if (!strcmp(argv[i], "-j")) {
+      if (i == argc - 1) {
+        fprintf(mgr->log, "*** argument to '-j' missing (try '-h')\n");
+        error = 1;
+      } else if ((mgr->threads = atoi(argv[++i])) < 1) {
+        fprintf(mgr->log, "*** invalid number of threads '%s' (try '-h')\n",
+                argv[i]);
+        error = 1;
+      }
     } else if (!strcmp(argv[i], "-o")) {
       if (i == argc - 1) {
         fprintf(mgr->log, "*** argument to '-o' missing (try '-h')\n");
@@ -1497,9 +7307,39 @@ int limboole_extended(int argc, char **argv, int op, char *input,
         mgr->log = file;
         mgr->close_log = 1;
       }
+    } else if (!strcmp(argv[i], "--batch")) {
+      /* already handled */
+    }
+#ifdef LIMBOOLE_PORTFOLIO
+    else if (!strcmp(argv[i], "--threads")) {
+      if (i == argc - 1) {
+        fprintf(mgr->log, "*** argument to '--threads' missing (try '-h')\n");
+        error = 1;
+      } else if ((mgr->portfolio = atoi(argv[++i])) < 1) {
+        fprintf(mgr->log, "*** invalid number of threads '%s' (try '-h')\n",
+                argv[i]);
+        error = 1;
+      }
+    }
+#endif
+#ifdef LIMBOOLE_RACE
+    else if (!strcmp(argv[i], "--race")) {
+      mgr->race = 1;
+    }
+#endif
+#ifdef LIMBOOLE_USE_SERVE
+    else if (!strcmp(argv[i], "--serve")) {
+      if (i == argc - 1) {
+        fprintf(mgr->log, "*** argument to '--serve' missing (try '-h')\n");
+        error = 1;
+      } else {
+        serve_path = argv[++i];
+      }
     }
+#endif
 #ifdef LIMBOOLE_USE_PICOSAT
     else if (!strcmp(argv[i], "--picosat")) {
+      solver_option = 1;
       mgr->use_lingeling = 0;
       mgr->use_picosat = 1;
       mgr->use_depqbf = 0;
@@ -1507,6 +7347,7 @@ int limboole_extended(int argc, char **argv, int op, char *input,
 #endif
 #ifdef LIMBOOLE_USE_LINGELING
     else if (!strcmp(argv[i], "--lingeling")) {
+      solver_option = 1;
       mgr->use_lingeling = 1;
       mgr->use_picosat = 0;
       mgr->use_depqbf = 0;
@@ -1514,6 +7355,7 @@ int limboole_extended(int argc, char **argv, int op, char *input,
 #endif
 #ifdef LIMBOOLE_USE_DEPQBF
     else if (!strcmp(argv[i], "--depqbf")) {
+      solver_option = 1;
       mgr->use_lingeling = 0;
       mgr->use_picosat = 0;
       mgr->use_depqbf = 1;
@@ -1523,6 +7365,8 @@ int limboole_extended(int argc, char **argv, int op, char *input,
       fprintf(mgr->log, "*** invalid command line option '%s' (try '-h')\n",
               argv[i]);
       error = 1;
+    } else if (batch) {
+      files[num_files++] = argv[i];
     } else if (mgr->close_in) {
       fprintf(mgr->log, "*** can not read more than two files (try '-h')\n");
       error = 1;
@@ -1539,78 +7383,67 @@ int limboole_extended(int argc, char **argv, int op, char *input,
   assert(mgr->use_lingeling || mgr->use_picosat || mgr->use_depqbf);
   assert(mgr->use_lingeling + mgr->use_picosat + mgr->use_depqbf == 1);
 
-  connect_solver(mgr);
+  /* Dumps are written directly without solver instance.
+   */
+  mgr->qdump = mgr->dump && mgr->use_depqbf;
 
-  if (!error && !done) {
-    next_token(mgr);
-#ifdef LIMBOOLE_USE_DEPQBF
-    if (mgr->use_depqbf)
-      error = !parse_prefix(mgr);
-#endif
+  if (mgr->race && mgr->use_depqbf && !error && !done) {
+    fprintf(mgr->log, "*** '--race' only for propositional formulas\n");
+    error = 1;
+  }
 
-    error = !parse(mgr);
+  if (mgr->portfolio > 1 && !error && !done) {
+    if (!mgr->use_picosat) {
+      fprintf(mgr->log, "*** '--threads' only with PicoSAT\n");
+      error = 1;
+    } else if (mgr->race) {
+      fprintf(mgr->log, "*** can not combine '--threads' and '--race'\n");
+      error = 1;
+    }
+  }
 
-    if (!error) {
-      if (pretty_print || mgr->qdump)
-      {
-        if (pretty_print)
-          pp(mgr);
-        if (mgr->qdump) {
-          fprintf(mgr->out, "c generated with pretty printer of DepQBF\n");
-#ifdef LIMBOOLE_USE_DEPQBF
-          qdpll_print(mgr->qdpll, mgr->out);
-#endif
-        }
+  if (serve_path && !error && !done &&
+      (batch || pretty_print || mgr->dump || mgr->dag || mgr->close_in ||
+       mgr->close_out || mgr->race || mgr->portfolio > 1 ||
+       mgr->check_satisfiability || mgr->use_depqbf || solver_option)) {
+    fprintf(mgr->log, "*** '--serve' only combines with '-j', '-v' and '-l'\n");
+    error = 1;
+  }
 
-      }
-      else {
-        tseitin(mgr);
-        if (!mgr->dump) {
-#ifdef LIMBOOLE_USE_LINGELING
-          res = 0;
-          if (mgr->lgl)
-            res = lglsat(mgr->lgl);
-#endif
-#ifdef LIMBOOLE_USE_PICOSAT
-          if (mgr->picosat)
-            res = picosat_sat(mgr->picosat, -1);
+#ifdef LIMBOOLE_USE_SERVE
+  if (serve_path) {
+    if (!error && !done)
+      error = serve(mgr, serve_path);
+  } else
 #endif
-#ifdef LIMBOOLE_USE_DEPQBF
-          if (mgr->qdpll)
-            res = qdpll_sat(mgr->qdpll);
-#endif
-
-          if (res == 10) {
-            if(mgr->qdpll) {
-              fprintf (mgr->out, "%% TRUE FORMULA (satisfying assignment of outermost existential variables follows)\n");
-            } else {
-              if (mgr->check_satisfiability)
-                fprintf(mgr->out, "%% SATISFIABLE formula"
-                                  " (satisfying assignment follows)\n");
-              else
-                fprintf(mgr->out, "%% INVALID formula"
-                                  " (falsifying assignment follows)\n");
-            }
-
-            print_assignment(mgr);
-          } else if (res == 20) {
-            if(mgr->qdpll) {
-fprintf (mgr->out, "%% FALSE formula\n");
-            } else {
-            if (mgr->check_satisfiability)
-              fprintf(mgr->out, "%% UNSATISFIABLE formula\n");
-            else
-              fprintf(mgr->out, "%% VALID formula\n");
-            }
-          } else {
-            fprintf(mgr->out, "%% UNKNOWN result\n");
-          }
-        }
-      }
+  if (batch) {
+    if (!error && !done)
+      error = solve_batch(mgr, files, num_files, pretty_print);
+  } else {
+    if (!mgr->dump)
+      connect_solver(mgr);
+
+    if (!error && !done && !mgr->input && !load_input(mgr)) {
+      fprintf(mgr->log, "*** could not read '%s'\n",
+              mgr->name ? mgr->name : "<stdin>");
+      error = 1;
     }
+
+    if (!error && !done)
+      error = process(mgr, pretty_print);
   }
+  free(files);
 
   if (mgr->verbose) {
+    fprintf(mgr->log, "c %u nodes, %llu children, unique table size %u\n",
+            mgr->nodes_count, (unsigned long long) mgr->refs_count,
+            mgr->table_size);
+    fprintf(mgr->log, "c %llu bytes for nodes and children\n",
+            (unsigned long long) mgr->nodes_count *
+              (2 * sizeof (unsigned char) + 2 * sizeof (unsigned) + sizeof (int))
+            + mgr->refs_count * sizeof (Ref));
+    fprintf(mgr->log, "c %u symbols, %llu bytes of names\n",
+            mgr->symbols_count, (unsigned long long) mgr->pool_count);
 #ifdef LIMBOOLE_USE_LINGELING
     if (mgr->lgl)
       lglstats(mgr->lgl);
@@ -0,0 +1,41 @@
+#ifndef limboole_h_INCLUDED
+#define limboole_h_INCLUDED
+
+/*------------------------------------------------------------------------*/
+/* Run limboole on a command line.  For 'limboole_extended' the operation
+ * 'op' is 0 for validity, 1 for satisfiability, 2 for QBF validity and 3
+ * for QBF satisfiability, and a non zero 'input' replaces the input file.
+ */
+int limboole (int argc, char **argv);
+
+int limboole_extended (int argc, char **argv, int op, char *input,
+		       unsigned int input_length);
+
+/*------------------------------------------------------------------------*/
+/* Incremental sessions (only with PicoSAT) keep the formulas and the SAT
+ * solver alive between checks, which share the work done for the formulas
+ * added before.  Functions taking a formula return zero if it has a parse
+ * error, which is reported on <stderr>.
+ *
+ * 'limboole_session_add_formula' adds a formula permanently, while
+ * 'limboole_session_assume' only adds it for the next check.  Then
+ * 'limboole_session_check' checks the validity ('op' is 0) or the
+ * satisfiability ('op' is 1) of 'formula' under these formulas, or just
+ * their satisfiability if 'formula' is zero.  It returns 10 for a
+ * satisfying or falsifying assignment, which 'limboole_session_deref'
+ * gives as 1 (true), -1 (false) or 0 (unknown variable), and 20 for
+ * unsatisfiable or valid.  The assignment is only available until the
+ * next add, assume or check, and otherwise all variables are unknown.
+ */
+typedef struct LimbooleSession LimbooleSession;
+
+LimbooleSession *limboole_session_new (void);
+
+int limboole_session_add_formula (LimbooleSession *, const char *formula);
+int limboole_session_assume (LimbooleSession *, const char *formula);
+int limboole_session_check (LimbooleSession *, const char *formula, int op);
+int limboole_session_deref (LimbooleSession *, const char *name);
+
+void limboole_session_free (LimbooleSession *);
+
+#endif
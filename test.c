@@ -5,9 +5,14 @@
 #include <stdarg.h>
 #include <unistd.h>
 
-/*------------------------------------------------------------------------*/
+#ifdef LIMBOOLE_USE_SERVE
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#endif
 
-int limboole (int, char **);
+#include "limboole.h"
 
 /*------------------------------------------------------------------------*/
 
@@ -130,7 +135,7 @@ main (int argc, char **argv)
   run_all (&ts);
   printf ("%u ok, %u failed (out of %u)\n", ts.ok, ts.failed, ts.count);
 
-  return 0;
+  return ts.failed != 0;
 }
 
 /*------------------------------------------------------------------------*/
@@ -250,6 +255,308 @@ run (TestSuite * ts, int expected_res, int argc, ...)
   va_end (ap);
 }
 
+/*------------------------------------------------------------------------*/
+/* Run a test of the library API, which writes its results to 'log'.
+ */
+static void
+run_api (TestSuite * ts, const char *name, void (*test) (FILE *))
+{
+  char *out_name;
+  char *log_name;
+  FILE *log;
+  int res;
+  int len;
+
+  if (ts->pattern && !match (name, ts->pattern))
+    return;
+
+  printf ("%-20s ...", name);
+  fflush (stdout);
+
+  len = strlen (name);
+  out_name = (char *) malloc (len + 9);
+  sprintf (out_name, "log/%s.out", name);
+
+  log_name = (char *) malloc (len + 9);
+  sprintf (log_name, "log/%s.log", name);
+
+  res = 0;
+  if ((log = fopen (log_name, "w")))
+    {
+      test (log);
+      fclose (log);
+      res = cmp_files (out_name, log_name);
+    }
+
+  ts->count++;
+  if (res)
+    {
+      printf (" ok    ");
+      if (!erase (ts))
+	fputc ('\n', stdout);
+      ts->ok++;
+    }
+  else
+    {
+      printf (" failed\n");
+      ts->failed++;
+    }
+
+  free (out_name);
+  free (log_name);
+}
+
+/*------------------------------------------------------------------------*/
+/* Dumps a generated formula, large enough to be encoded in chunks with
+ * '-j', with and without threads, which should give the same clauses.
+ */
+static void
+parallel4 (FILE * log)
+{
+  char *seq[] = { "parallel4", "-d", "-o", "log/parallel4.seq",
+    "log/parallel4.in"
+  };
+  char *par[] = { "parallel4", "-d", "-j", "2", "-o", "log/parallel4.par",
+    "log/parallel4.in"
+  };
+  unsigned i, a, b, c, state;
+  FILE *file;
+
+  if (!(file = fopen ("log/parallel4.in", "w")))
+    return;
+
+  state = 1;
+  for (i = 0; i < 40000; i++)
+    {
+      a = (state = state * 1103515245 + 12345) >> 16;
+      b = (state = state * 1103515245 + 12345) >> 16;
+      c = (state = state * 1103515245 + 12345) >> 16;
+      fprintf (file, "%s(v%u | !v%u | (v%u <-> v%u))\n", i ? "& " : "",
+	       a % 200, b % 200, c % 200, a % 200);
+    }
+  fclose (file);
+
+  fprintf (log, "%d %d ", limboole (5, seq), limboole (7, par));
+  fprintf (log, "%s\n", cmp_files ("log/parallel4.seq", "log/parallel4.par")
+	   ? "same" : "different");
+}
+
+/*------------------------------------------------------------------------*/
+#ifdef LIMBOOLE_USE_PICOSAT
+
+static void
+check (FILE * log, LimbooleSession * session, const char *formula, int op)
+{
+  const char *names[] = { "a", "b", "c", "d" };
+  int res, i;
+
+  res = limboole_session_check (session, formula, op);
+  fprintf (log, "%s %s: %d", op ? "sat" : "valid",
+	   formula ? formula : "<none>", res);
+  if (res == 10)
+    for (i = 0; i < 4; i++)
+      fprintf (log, " %s=%d", names[i],
+	       limboole_session_deref (session, names[i]));
+  fputc ('\n', log);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+session0 (FILE * log)
+{
+  LimbooleSession *session;
+
+  session = limboole_session_new ();
+  limboole_session_add_formula (session, "(a -> b) & (b -> c)");
+  check (log, session, "a -> c", 0);
+  check (log, session, "c -> a", 0);
+  limboole_session_assume (session, "a");
+  check (log, session, "!c", 1);
+  check (log, session, "!c", 1);
+  limboole_session_add_formula (session, "atmost(1; b, d) & (d | a)");
+  check (log, session, "a & b & c & !d", 0);
+  check (log, session, 0, 1);
+  limboole_session_add_formula (session, "!c");
+  check (log, session, 0, 1);
+  check (log, session, "d & !a", 0);
+  limboole_session_free (session);
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+session1 (FILE * log)
+{
+  LimbooleSession *session;
+
+  session = limboole_session_new ();
+  fprintf (log, "new: a=%d\n", limboole_session_deref (session, "a"));
+  limboole_session_add_formula (session, "a & b");
+  check (log, session, 0, 1);
+  limboole_session_add_formula (session, "c | a");
+  fprintf (log, "added: a=%d\n", limboole_session_deref (session, "a"));
+  check (log, session, "a", 1);
+  limboole_session_assume (session, "c");
+  fprintf (log, "assumed: a=%d\n", limboole_session_deref (session, "a"));
+  check (log, session, "!a", 1);
+  fprintf (log, "unsat: a=%d\n", limboole_session_deref (session, "a"));
+  limboole_session_free (session);
+}
+
+#endif
+/*------------------------------------------------------------------------*/
+#ifdef LIMBOOLE_USE_SERVE
+
+static int
+send_request (int fd, unsigned id, int op, unsigned limit,
+	      const char *formula)
+{
+  char header[64];
+  unsigned len;
+
+  len = sprintf (header, "%u %d %u %lu\n", id, op, limit,
+		 (unsigned long) strlen (formula));
+
+  return write (fd, header, len) == (ssize_t) len
+    && write (fd, formula, strlen (formula)) == (ssize_t) strlen (formula);
+}
+
+static void
+receive_answer (FILE * log, int fd)
+{
+  char header[64], ch;
+  unsigned long size;
+  unsigned len, id;
+  int status;
+
+  for (len = 0; len + 1 < sizeof (header) && read (fd, &ch, 1) == 1
+       && ch != '\n'; len++)
+    header[len] = ch;
+  header[len] = 0;
+
+  if (sscanf (header, "%u %d %lu", &id, &status, &size) != 3)
+    {
+      fprintf (log, "invalid answer '%s'\n", header);
+      return;
+    }
+
+  fprintf (log, "%u %d\n", id, status);
+  while (size-- && read (fd, &ch, 1) == 1)
+    fputc (ch, log);
+}
+
+static void
+request (FILE * log, int fd, unsigned id, int op, unsigned limit,
+	 const char *formula)
+{
+  if (send_request (fd, id, op, limit, formula))
+    receive_answer (log, fd);
+}
+
+/*------------------------------------------------------------------------*/
+/* Pigeon hole formula with 'n' holes, which is unsatisfiable.
+ */
+static char *
+pigeons (unsigned n)
+{
+  unsigned p, q, h;
+  char *res, *s;
+
+  res = s = (char *) malloc (64 * (n + 1) * n * (n + 1));
+  for (p = 0; p <= n; p++)
+    {
+      s += sprintf (s, p ? " & (" : "(");
+      for (h = 0; h < n; h++)
+	s += sprintf (s, h ? " | p%u_%u" : "p%u_%u", p, h);
+      s += sprintf (s, ")");
+    }
+  for (h = 0; h < n; h++)
+    for (p = 0; p <= n; p++)
+      for (q = p + 1; q <= n; q++)
+	s += sprintf (s, " & (!p%u_%u | !p%u_%u)", p, h, q, h);
+
+  return res;
+}
+
+/*------------------------------------------------------------------------*/
+
+static void
+serve0 (FILE * log)
+{
+  char *argv[] = { "serve0", "-j", "2", "--serve", "log/serve0.sock" };
+  char *second[] = { "serve0", "-l", "/dev/null", "--serve",
+    "log/serve0.sock"
+  };
+  struct sockaddr_un addr;
+  char *hard;
+  int status;
+  pid_t pid;
+  int fd, i;
+
+  if (!(pid = fork ()))
+    _exit (limboole (5, argv));
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, argv[4]);
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  for (i = 0; i < 500; i++)
+    if (!connect (fd, (struct sockaddr *) &addr, sizeof (addr)))
+      break;
+    else
+      usleep (10000);
+
+  /* A second server does not take over the socket of a running one.
+   */
+  fprintf (log, "second server %d\n", limboole (5, second));
+
+  hard = pigeons (8);
+  request (log, fd, 1, 0, 0, "a | !a");
+  request (log, fd, 2, 1, 0, "(a -> b) & a");
+  request (log, fd, 3, 0, 0, "a &");
+  request (log, fd, 4, 1, 1000, hard);
+  request (log, fd, 5, 3, 0, "?a #b (a <-> b)");
+  request (log, fd, 6, 4, 0, "a");
+  free (hard);
+
+  /* Requests sent before shutting down writing are still answered.
+   */
+  if (send_request (fd, 7, 1, 0, "a & !b"))
+    {
+      shutdown (fd, SHUT_WR);
+      receive_answer (log, fd);
+    }
+  close (fd);
+
+  fd = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (!connect (fd, (struct sockaddr *) &addr, sizeof (addr))
+      && write (fd, "8 1 0 -1\n", 9) == 9)
+    receive_answer (log, fd);
+  close (fd);
+
+  kill (pid, SIGTERM);
+  waitpid (pid, &status, 0);
+  fprintf (log, "exit %d\n", WIFEXITED (status) ? WEXITSTATUS (status) : -1);
+}
+
+/*------------------------------------------------------------------------*/
+/* The driver of 'run' already uses '-o', which '--serve' rejects.
+ */
+static void
+serve2 (FILE * log)
+{
+  char *argv[] = { "serve2", "-l", "/dev/null", "-o", "/dev/null",
+    "--serve", "log/serve2.sock"
+  };
+
+  fprintf (log, "serve with output file %d\n", limboole (7, argv));
+  fprintf (log, "socket %s\n",
+	   access ("log/serve2.sock", F_OK) ? "missing" : "created");
+}
+
+#endif
 /*------------------------------------------------------------------------*/
 
 static void
@@ -265,7 +572,6 @@ run_all (TestSuite * ts)
   run (ts, 1, 3, "twologfiles", "-l", "/dev/null");
   run (ts, 1, 2, "invalidoption", "-invalid-option");
   run (ts, 1, 2, "infilenotreadable", "/a-non-existing-file");
-  run (ts, 1, 2, "missingmpara", "-m");
   run (ts, 1, 3, "twofiles", "log/twofiles.in", "/dev/null");
   run (ts, 0, 3, "var0", "-p", "log/var0.in");
   run (ts, 1, 3, "var1", "-p", "log/var1.in");
@@ -318,11 +624,62 @@ run_all (TestSuite * ts)
   run (ts, 0, 2, "valid0", "log/valid0.in");
   run (ts, 0, 2, "valid1", "log/valid1.in");
   run (ts, 0, 2, "valid2", "log/valid2.in");
-  run (ts, 1, 4, "valid3", "-m", "0", "log/valid3.in");
   run (ts, 0, 2, "valid4", "log/valid4.in");
   run (ts, 0, 2, "valid5", "log/valid5.in");
   run (ts, 0, 3, "sat2", "-s", "log/sat2.in");
   run (ts, 0, 3, "prime9", "-s", "log/prime9.in");
   run (ts, 0, 2, "count2live", "log/count2live.in");
   run (ts, 0, 2, "count2stall", "log/count2stall.in");
+  run (ts, 0, 5, "parallel0", "-j", "4", "-p", "log/parallel0.in");
+  run (ts, 0, 5, "parallel1", "-j", "4", "-d", "log/parallel1.in");
+  run (ts, 1, 4, "parallel2", "-j", "4", "log/parallel2.in");
+  run (ts, 0, 4, "parallel3", "-j", "3", "log/count2live.in");
+  run (ts, 0, 4, "compile0", "-c", "log/compile0.dag", "log/compile0.in");
+  run (ts, 0, 3, "compiled0", "-d", "log/compile0.dag");
+  run (ts, 0, 3, "compiled1", "-p", "log/compile0.dag");
+  run (ts, 1, 2, "compiledbad", "log/compiledbad.in");
+  run (ts, 0, 2, "normalize0", "log/normalize0.in");
+  run (ts, 0, 3, "fold0", "-s", "log/fold0.in");
+  run (ts, 0, 2, "fold1", "log/fold1.in");
+  run (ts, 0, 2, "fold2", "log/fold2.in");
+  run (ts, 0, 3, "fold3", "-s", "log/fold3.in");
+  run (ts, 0, 3, "cnf0", "-s", "log/cnf0.in");
+  run (ts, 0, 3, "cnf1", "-s", "log/cnf1.in");
+  run (ts, 0, 3, "ite0", "-p", "log/ite0.in");
+  run (ts, 0, 3, "ite1", "-s", "log/ite1.in");
+  run (ts, 0, 2, "ite2", "log/ite2.in");
+  run (ts, 1, 2, "ite3", "log/ite3.in");
+  run (ts, 0, 3, "ite4", "-d", "log/ite4.in");
+  run (ts, 0, 3, "card0", "-p", "log/card0.in");
+  run (ts, 0, 3, "card1", "-s", "log/card1.in");
+  run (ts, 0, 2, "card2", "log/card2.in");
+  run (ts, 1, 2, "card3", "log/card3.in");
+  run (ts, 1, 2, "card4", "log/card4.in");
+  run (ts, 0, 4, "qdump0", "--depqbf", "-d", "log/qdump0.in");
+  run (ts, 0, 5, "qdump1", "--depqbf", "-s", "-d", "log/qdump1.in");
+  run (ts, 0, 2, "xor0", "log/xor0.in");
+  run (ts, 0, 3, "xor1", "-s", "log/xor1.in");
+  run (ts, 0, 3, "xor2", "-s", "log/xor2.in");
+  run (ts, 0, 4, "batch0", "--batch", "log/batch0.in", "log/batch1.in");
+  run (ts, 0, 7, "batch1", "--batch", "-j", "2", "-s", "log/batch0.in",
+       "log/batch1.in");
+  run (ts, 0, 3, "batch2", "--batch", "log/batch2.in");
+#if defined(LIMBOOLE_USE_PICOSAT) && defined(LIMBOOLE_USE_DEPQBF) && \
+    defined(LIMBOOLE_USE_THREADS)
+  run (ts, 0, 3, "race0", "--race", "log/race0.in");
+#endif
+#if defined(LIMBOOLE_USE_PICOSAT) && defined(LIMBOOLE_USE_THREADS)
+  run (ts, 0, 5, "portfolio0", "-s", "--threads", "3", "log/portfolio0.in");
+#endif
+  run_api (ts, "parallel4", parallel4);
+#ifdef LIMBOOLE_USE_PICOSAT
+  run_api (ts, "session0", session0);
+  run_api (ts, "session1", session1);
+#endif
+#ifdef LIMBOOLE_USE_SERVE
+  run_api (ts, "serve0", serve0);
+  run (ts, 1, 4, "serve1", "-s", "--serve", "log/serve1.sock");
+  run_api (ts, "serve2", serve2);
+  run (ts, 1, 4, "serve3", "--picosat", "--serve", "log/serve3.sock");
+#endif
 }